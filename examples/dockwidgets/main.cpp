@@ -58,6 +58,9 @@ int main(int argc, char **argv)
     QCommandLineOption lazyResizeOption("l", QCoreApplication::translate("main", "Use lazy resize"));
     parser.addOption(lazyResizeOption);
 
+    QCommandLineOption framePacedResizeOption("e", QCoreApplication::translate("main", "Resize at most once per display frame while dragging separators"));
+    parser.addOption(framePacedResizeOption);
+
     QCommandLineOption multipleMainWindows("m", QCoreApplication::translate("main", "Shows two multiple main windows"));
     parser.addOption(multipleMainWindows);
 
@@ -127,6 +130,9 @@ int main(int argc, char **argv)
     if (parser.isSet(lazyResizeOption))
         flags |= KDDockWidgets::Config::Flag_LazyResize;
 
+    if (parser.isSet(framePacedResizeOption))
+        flags |= KDDockWidgets::Config::Flag_FramePacedResize;
+
     if (parser.isSet(tabsHaveCloseButton))
         flags |= KDDockWidgets::Config::Flag_TabsHaveCloseButton;
 
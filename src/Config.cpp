@@ -55,6 +55,7 @@ public:
 
     QQmlEngine *m_qmlEngine = nullptr;
     DockWidgetFactoryFunc m_dockWidgetFactoryFunc = nullptr;
+    DockWidgetContentFactoryFunc m_dockWidgetContentFactoryFunc = nullptr;
     MainWindowFactoryFunc m_mainWindowFactoryFunc = nullptr;
     FrameworkWidgetFactory *m_frameworkWidgetFactory;
     Flags m_flags = Flag_Default;
@@ -101,6 +102,7 @@ void Config::setFlags(Flags f)
 
     auto multisplitterFlags = Layouting::Config::self().flags();
     multisplitterFlags.setFlag(Layouting::Config::Flag::LazyResize, d->m_flags & Flag_LazyResize);
+    multisplitterFlags.setFlag(Layouting::Config::Flag::FramePacedResize, d->m_flags & Flag_FramePacedResize);
     Layouting::Config::self().setFlags(multisplitterFlags);
 }
 
@@ -114,6 +116,16 @@ DockWidgetFactoryFunc Config::dockWidgetFactoryFunc() const
     return d->m_dockWidgetFactoryFunc;
 }
 
+void Config::setDockWidgetContentFactoryFunc(DockWidgetContentFactoryFunc func)
+{
+    d->m_dockWidgetContentFactoryFunc = func;
+}
+
+DockWidgetContentFactoryFunc Config::dockWidgetContentFactoryFunc() const
+{
+    return d->m_dockWidgetContentFactoryFunc;
+}
+
 void Config::setMainWindowFactoryFunc(MainWindowFactoryFunc func)
 {
     d->m_mainWindowFactoryFunc = func;
@@ -32,6 +32,7 @@
 
 QT_BEGIN_NAMESPACE
 class QQmlEngine;
+class QWidget;
 QT_END_NAMESPACE
 
 namespace KDDockWidgets
@@ -43,6 +44,7 @@ class FrameworkWidgetFactory;
 
 typedef KDDockWidgets::DockWidgetBase* (*DockWidgetFactoryFunc)(const QString &name);
 typedef KDDockWidgets::MainWindowBase* (*MainWindowFactoryFunc)(const QString &name);
+typedef QWidget* (*DockWidgetContentFactoryFunc)(KDDockWidgets::DockWidgetBase *dockWidget);
 
 /**
  * @brief Singleton to allow to choose certain behaviours of the framework.
@@ -72,6 +74,7 @@ public:
         Flag_TabsHaveCloseButton = 64, /// Tabs will have a close button. Equivalent to QTabWidget::setTabsClosable(true).
         Flag_DoubleClickMaximizes = 128, /// Double clicking the titlebar will maximize a floating window instead of re-docking it
         Flag_TitleBarHasMaximizeButton = 256, /// The title bar will have a maximize/restore button when floating. This is mutually-exclusive with the floating button (since many apps behave that way).
+        Flag_FramePacedResize = 512, /// While dragging a separator, mouse moves are coalesced and the dock widgets are resized at most once per display frame. Ignored if Flag_LazyResize is set.
         Flag_Default = Flag_AeroSnapWithClientDecos ///> The defaults
     };
     Q_DECLARE_FLAGS(Flags, Flag)
@@ -104,6 +107,22 @@ public:
     ///nullptr by default
     DockWidgetFactoryFunc dockWidgetFactoryFunc() const;
 
+    /**
+     * @brief Registers a DockWidgetContentFactoryFunc, to create dock widget contents on demand.
+     *
+     * This is optional, the default is nullptr.
+     *
+     * When set, a DockWidget without a widget gets one from this function the first time it's shown.
+     * Pair it with a DockWidgetFactoryFunc that only creates the DockWidget, with its title and icon,
+     * and restoring a layout no longer pays for contents nobody is looking at, like non-current
+     * tabs and closed dock widgets.
+     */
+    void setDockWidgetContentFactoryFunc(DockWidgetContentFactoryFunc);
+
+    ///@brief Returns the DockWidgetContentFactoryFunc.
+    ///nullptr by default
+    DockWidgetContentFactoryFunc dockWidgetContentFactoryFunc() const;
+
     ///@brief counter-part of DockWidgetFactoryFunc but for the main window.
     /// Should be rarely used. It's good practice to have the main window before restoring a layout.
     /// It's here so we can use it in the linter executable
@@ -24,6 +24,7 @@
 #include "Logging_p.h"
 #include "Utils_p.h"
 #include "DockRegistry_p.h"
+#include "AffinitySet_p.h"
 #include "DropArea_p.h"
 #include "multisplitter/Item_p.h"
 #include "Config.h"
@@ -95,6 +96,7 @@ public:
     void updateFloatAction();
     void onDockWidgetShown();
     void onDockWidgetHidden();
+    void maybeCreateContent();
     void show();
     void close();
     void restoreToPreviousPosition();
@@ -109,6 +111,7 @@ public:
 
     const QString name;
     QStringList affinities;
+    AffinitySet affinitySet;
     QString title;
     QIcon icon;
     QWidget *widget = nullptr;
@@ -154,7 +157,7 @@ void DockWidgetBase::addDockWidgetAsTab(DockWidgetBase *other, AddingOption addi
         return;
     }
 
-    if (!DockRegistry::self()->affinitiesMatch(other->affinities(), d->affinities)) {
+    if (!DockRegistry::self()->affinitiesMatch(other->affinitySet(), d->affinitySet)) {
         qWarning() << Q_FUNC_INFO << "Refusing to dock widget with incompatible affinity."
                    << other->affinities() << affinities();
         return;
@@ -197,7 +200,7 @@ void DockWidgetBase::addDockWidgetToContainingWindow(DockWidgetBase *other, Loca
         return;
     }
 
-    if (!DockRegistry::self()->affinitiesMatch(other->affinities(), d->affinities)) {
+    if (!DockRegistry::self()->affinitiesMatch(other->affinitySet(), d->affinitySet)) {
         qWarning() << Q_FUNC_INFO << "Refusing to dock widget with incompatible affinity."
                    << other->affinities() << affinities();
         return;
@@ -391,6 +394,11 @@ QStringList DockWidgetBase::affinities() const
     return d->affinities;
 }
 
+const AffinitySet &DockWidgetBase::affinitySet() const
+{
+    return d->affinitySet;
+}
+
 void DockWidgetBase::show()
 {
     if (isWindow() && (d->m_lastPositions.wasFloating() || !d->m_lastPositions.isValid())) {
@@ -441,6 +449,7 @@ void DockWidgetBase::setAffinities(const QStringList &affinityNames)
     }
 
     d->affinities = affinities;
+    d->affinitySet = AffinitySet(affinities);
 }
 
 FloatingWindow *DockWidgetBase::morphIntoFloatingWindow()
@@ -580,6 +589,18 @@ void DockWidgetBase::Private::onDockWidgetShown()
     qCDebug(hiding) << Q_FUNC_INFO << "parent=" << q->parentWidget();
 }
 
+void DockWidgetBase::Private::maybeCreateContent()
+{
+    if (widget)
+        return;
+
+    // Lazy dock widget, created without contents. See Config::setDockWidgetContentFactoryFunc().
+    if (auto func = Config::self().dockWidgetContentFactoryFunc()) {
+        if (QWidget *content = func(q))
+            q->setWidget(content);
+    }
+}
+
 void DockWidgetBase::Private::onDockWidgetHidden()
 {
     updateToggleAction();
@@ -678,6 +699,7 @@ void DockWidgetBase::onParentChanged()
 
 void DockWidgetBase::onShown(bool spontaneous)
 {
+    d->maybeCreateContent();
     d->onDockWidgetShown();
     Q_EMIT shown();
 
@@ -734,6 +756,7 @@ DockWidgetBase *DockWidgetBase::deserialize(const LayoutSaver::DockWidget::Ptr &
             qWarning() << Q_FUNC_INFO << "Affinity name changed from" << dw->affinities()
                        << "; to" << saved->affinities;
             dw->d->affinities = saved->affinities;
+            dw->d->affinitySet = AffinitySet(saved->affinities);
         }
 
     } else {
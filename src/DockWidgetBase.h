@@ -56,6 +56,7 @@ class TabWidget;
 class TitleBar;
 class MainWindowBase;
 class StateDragging;
+class AffinitySet;
 
 /**
  * @brief The DockWidget base-class. DockWidget and DockWidgetBase are only
@@ -368,6 +369,7 @@ private:
     friend class KDDockWidgets::DragController;
     friend class KDDockWidgets::DockRegistry;
     friend class KDDockWidgets::LayoutSaver;
+    friend class KDDockWidgets::MainWindowBase;
 
     /**
      * @brief the Frame which contains this dock widgets.
@@ -396,6 +398,9 @@ private:
     ///@brief If this dock widget is floating, then it saves its geometry
     void saveLastFloatingGeometry();
 
+    ///@brief returns the interned affinities(), for fast matching
+    const AffinitySet &affinitySet() const;
+
     class Private;
     Private *const d;
 };
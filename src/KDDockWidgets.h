@@ -70,6 +70,9 @@ namespace KDDockWidgets
         RestoreOption_None = 0,
         RestoreOption_RelativeToMainWindow = 1, ///< Skips restoring the main window geometry and the restored dock widgets will use relative sizing.
                                                 ///< Loading layouts won't change the main window geometry and just use whatever the user has at the moment.
+        RestoreOption_Incremental = 2, ///< Main windows with the same dock widget arrangement as the saved layout keep their frames, only their sizes are restored.
+                                       ///< Other windows get a new arrangement, but frames with the same dock widgets are kept, only the others are created or closed.
+                                       ///< Useful when switching between similar layouts, as there's less flicker and reparenting.
     };
     Q_DECLARE_FLAGS(RestoreOptions, RestoreOption)
 
@@ -29,6 +29,7 @@
 #include "LayoutSaver_p.h"
 #include "Config.h"
 #include "DockRegistry_p.h"
+#include "AffinitySet_p.h"
 #include "DockWidgetBase.h"
 #include "DropArea_p.h"
 #include "Logging_p.h"
@@ -43,7 +44,22 @@
 #include <QSettings>
 #include <QApplication>
 #include <QFile>
-
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QLocale>
+#include <qnumeric.h>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QTimer>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+# include <QCborArray>
+# include <QCborMap>
+# include <QCborValue>
+#endif
+
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
 using namespace KDDockWidgets;
@@ -64,245 +80,1635 @@ public:
 
         ~RAIIIsRestoring()
         {
-            LayoutSaver::Private::s_restoreInProgress = false;
+            LayoutSaver::Private::s_restoreInProgress = false;
+        }
+        Q_DISABLE_COPY(RAIIIsRestoring)
+    };
+
+    Private(RestoreOptions options)
+        : m_dockRegistry(DockRegistry::self())
+        , m_restoreOptions(options)
+    {
+    }
+
+    bool matchesAffinity(const QStringList &affinities) const {
+        return m_affinityNames.isEmpty() || affinities.isEmpty() || DockRegistry::self()->affinitiesMatch(m_affinitySet, AffinitySet(affinities));
+    }
+
+    bool matchesAffinity(const AffinitySet &affinities) const {
+        return m_affinityNames.isEmpty() || affinities.isEmpty() || DockRegistry::self()->affinitiesMatch(m_affinitySet, affinities);
+    }
+
+    struct LayoutCollector;
+    struct RestoreJob;
+
+    template <typename T>
+    void deserializeWindowGeometry(const T &saved, QWidgetOrQuick *topLevel) const;
+    bool mainWindowMatches(MainWindowBase *mainWindow, const LayoutSaver::MainWindow &saved) const;
+    void deleteEmptyFrames() const;
+    void clearRestoredProperty();
+
+    ///@brief Fills @p layout with the current state. Returns false if the layout can't be serialized right now.
+    bool collectLayout(LayoutSaver::Layout &layout) const;
+
+    std::unique_ptr<QSettings> settings() const;
+    DockRegistry *const m_dockRegistry;
+    const RestoreOptions m_restoreOptions;
+    QStringList m_affinityNames;
+    AffinitySet m_affinitySet; // m_affinityNames, interned
+    Format m_format = Format::Json;
+
+    static bool s_restoreInProgress;
+};
+
+bool LayoutSaver::Private::s_restoreInProgress = false;
+
+///@brief Fills a Layout with the current state, one window or dock widget per step(), see collectLayout()
+struct LayoutSaver::Private::LayoutCollector
+{
+    LayoutCollector(const Private &saver, LayoutSaver::Layout &layout);
+
+    ///@brief Lists what will be serialized. Returns false if the layout can't be serialized right now.
+    bool begin();
+    void step();
+    bool isDone() const { return index >= numSteps(); }
+    int numSteps() const;
+
+    const Private &d;
+    LayoutSaver::Layout &layout;
+    QVector<QPointer<MainWindowBase>> mainWindows;
+    QVector<QPointer<KDDockWidgets::FloatingWindow>> floatingWindows;
+    QVector<QPointer<DockWidgetBase>> closedDockWidgets;
+    QVector<QPointer<DockWidgetBase>> dockWidgets;
+    int index = 0;
+
+private:
+    Q_DISABLE_COPY(LayoutCollector)
+};
+
+///@brief The steps of a restore, so it can either run in one go or in time slices, see AsyncLayoutRestore
+struct LayoutSaver::Private::RestoreJob
+{
+    enum class Phase {
+        Parse,
+        Clear,
+        MainWindows,
+        FloatingWindows,
+        ClosedDockWidgets,
+        Placeholders,
+        Done
+    };
+
+    RestoreJob(const Private &saver, const QByteArray &jsonData);
+    ~RestoreJob();
+
+    ///@brief Runs the next step. Returns false if restoring failed.
+    bool step();
+    bool isDone() const { return phase == Phase::Done; }
+    int numSteps() const;
+
+    const Private &d;
+    const QByteArray data;
+    Phase phase = Phase::Parse;
+    int index = 0;
+    int stepsDone = 0;
+    RAIIIsRestoring isRestoring;
+    LayoutSaver::Layout layout;
+    QVector<QPointer<MainWindowBase>> unchangedMainWindows;
+    QVector<QPointer<Layouting::Item>> pinnedItems;
+    QHash<QString, QPointer<KDDockWidgets::Frame>> reusedFrames; // by saved frame id
+    QHash<int, QPointer<KDDockWidgets::FloatingWindow>> reusedFloatingWindows; // by index into layout.floatingWindows
+    std::unique_ptr<DockRegistry::ClearJob> clearJob;
+    int numClearSteps = 0;
+
+private:
+    void nextPhase(Phase);
+    int numMatchSteps() const;
+    void matchMainWindow(const LayoutSaver::MainWindow &);
+    void matchFloatingWindow(int index);
+    int matchFrames(const LayoutSaver::MultiSplitter &, KDDockWidgets::MultiSplitter *);
+    QHash<QString, KDDockWidgets::Frame *> reusedFramesFor(const LayoutSaver::MultiSplitter &,
+                                                           KDDockWidgets::MultiSplitter *) const;
+    void clearStep();
+    bool restoreMainWindow(const LayoutSaver::MainWindow &);
+    bool restoreFloatingWindow(int index);
+    Q_DISABLE_COPY(RestoreJob)
+};
+
+
+static QVariantList stringListToVariant(const QStringList &strs)
+{
+    QVariantList variantList;
+    variantList.reserve(strs.size());
+    for (const QString &str : strs)
+        variantList.push_back(str);
+
+    return variantList;
+}
+
+///@brief The keys used by the layout format.
+///Shared by the writers and the parsers, so each key is spelled out only once
+namespace Keys {
+static const QLatin1String affinities("affinities");
+static const QLatin1String affinityName("affinityName");
+static const QLatin1String allDockWidgets("allDockWidgets");
+static const QLatin1String children("children");
+static const QLatin1String closedDockWidgets("closedDockWidgets");
+static const QLatin1String currentTabIndex("currentTabIndex");
+static const QLatin1String devicePixelRatio("devicePixelRatio");
+static const QLatin1String dockWidgets("dockWidgets");
+static const QLatin1String floatingWindows("floatingWindows");
+static const QLatin1String frames("frames");
+static const QLatin1String guestId("guestId");
+static const QLatin1String geometry("geometry");
+static const QLatin1String height("height");
+static const QLatin1String id("id");
+static const QLatin1String index("index");
+static const QLatin1String indexOfFloatingWindow("indexOfFloatingWindow");
+static const QLatin1String isContainer("isContainer");
+static const QLatin1String isFloatingWindow("isFloatingWindow");
+static const QLatin1String isNull("isNull");
+static const QLatin1String isVisible("isVisible");
+static const QLatin1String itemIndex("itemIndex");
+static const QLatin1String lastFloatingGeometry("lastFloatingGeometry");
+static const QLatin1String lastPosition("lastPosition");
+static const QLatin1String layout("layout");
+static const QLatin1String mainWindowUniqueName("mainWindowUniqueName");
+static const QLatin1String mainWindows("mainWindows");
+static const QLatin1String multiSplitterLayout("multiSplitterLayout");
+static const QLatin1String name("name");
+static const QLatin1String objectName("objectName");
+static const QLatin1String options("options");
+static const QLatin1String orientation("orientation");
+static const QLatin1String parentIndex("parentIndex");
+static const QLatin1String placeholders("placeholders");
+static const QLatin1String screenIndex("screenIndex");
+static const QLatin1String screenInfo("screenInfo");
+static const QLatin1String screenSize("screenSize");
+static const QLatin1String serializationVersion("serializationVersion");
+static const QLatin1String tabIndex("tabIndex");
+static const QLatin1String uniqueName("uniqueName");
+static const QLatin1String wasFloating("wasFloating");
+static const QLatin1String width("width");
+static const QLatin1String x("x");
+static const QLatin1String y("y");
+}
+
+static QRect jsonToRect(const QJsonValue &value)
+{
+    const QJsonObject object = value.toObject();
+    return QRect(object.value(Keys::x).toInt(),
+                 object.value(Keys::y).toInt(),
+                 object.value(Keys::width).toInt(),
+                 object.value(Keys::height).toInt());
+}
+
+static QSize jsonToSize(const QJsonValue &value)
+{
+    const QJsonObject object = value.toObject();
+    return { object.value(Keys::width).toInt(),
+             object.value(Keys::height).toInt() };
+}
+
+static QStringList jsonToStringList(const QJsonValue &value)
+{
+    const QJsonArray array = value.toArray();
+    QStringList stringList;
+    stringList.reserve(array.size());
+    for (const QJsonValue &v : array)
+        stringList.push_back(v.toString());
+
+    return stringList;
+}
+
+/// Binary layouts start with the CBOR self-describe tag, so they're told apart from JSON
+static bool isBinaryLayout(const QByteArray &data)
+{
+    return data.startsWith("\xD9\xD9\xF7");
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+///@brief The keys of binary layouts are replaced by their index in this table, which is much smaller.
+///Keys not in the table, like frame ids, stay strings. Only append to it, the tags are part of the format.
+static const QLatin1String s_binaryKeys[] = {
+    Keys::affinities, Keys::affinityName, Keys::allDockWidgets, Keys::closedDockWidgets,
+    Keys::currentTabIndex, Keys::devicePixelRatio, Keys::dockWidgets, Keys::floatingWindows,
+    Keys::frames, Keys::geometry, Keys::height, Keys::id, Keys::index, Keys::indexOfFloatingWindow,
+    Keys::isFloatingWindow, Keys::isNull, Keys::isVisible, Keys::itemIndex, Keys::lastFloatingGeometry,
+    Keys::lastPosition, Keys::layout, Keys::mainWindowUniqueName, Keys::mainWindows,
+    Keys::multiSplitterLayout, Keys::name, Keys::objectName, Keys::options, Keys::parentIndex,
+    Keys::placeholders, Keys::screenIndex, Keys::screenInfo, Keys::screenSize,
+    Keys::serializationVersion, Keys::tabIndex, Keys::uniqueName, Keys::wasFloating, Keys::width,
+    Keys::x, Keys::y,
+    // The Item tree, see Layouting::Item::toJsonObject()
+    Keys::children, Keys::guestId, Keys::isContainer,
+    QLatin1String("maxSize"), QLatin1String("minSize"), Keys::orientation,
+    QLatin1String("sizingInfo")
+};
+
+static const int s_numBinaryKeys = int(sizeof(s_binaryKeys) / sizeof(s_binaryKeys[0]));
+
+static int binaryTagForKey(const QString &key)
+{
+    static const QHash<QString, int> s_tags = [] {
+        QHash<QString, int> tags;
+        tags.reserve(s_numBinaryKeys);
+        for (int i = 0; i < s_numBinaryKeys; ++i)
+            tags.insert(s_binaryKeys[i], i);
+        return tags;
+    }();
+
+    return s_tags.value(key, -1);
+}
+
+///@brief Overload for the Keys, which are looked up without converting them to QString first
+static int binaryTagForKey(QLatin1String key)
+{
+    static const QHash<QLatin1String, int> s_tags = [] {
+        QHash<QLatin1String, int> tags;
+        tags.reserve(s_numBinaryKeys);
+        for (int i = 0; i < s_numBinaryKeys; ++i)
+            tags.insert(s_binaryKeys[i], i);
+        return tags;
+    }();
+
+    return s_tags.value(key, -1);
+}
+
+///@brief The inverse of CborWriter
+static QJsonValue binaryToJson(const QCborValue &value)
+{
+    if (value.isMap()) {
+        QJsonObject result;
+        const QCborMap map = value.toMap();
+        for (auto it = map.cbegin(), end = map.cend(); it != end; ++it) {
+            const QCborValue key = it.key();
+            if (key.isString()) {
+                result.insert(key.toString(), binaryToJson(it.value()));
+                continue;
+            }
+
+            const qint64 tag = key.toInteger(-1);
+            if (tag < 0 || tag >= s_numBinaryKeys) {
+                qWarning() << Q_FUNC_INFO << "Unknown key" << key;
+                continue;
+            }
+            result.insert(s_binaryKeys[tag], binaryToJson(it.value()));
+        }
+        return result;
+    }
+
+    if (value.isArray()) {
+        QJsonArray result;
+        const QCborArray array = value.toArray();
+        for (const QCborValue &v : array)
+            result.append(binaryToJson(v));
+        return result;
+    }
+
+    return value.toJsonValue();
+}
+
+///@brief Parses a binary layout. Returns a null QJsonObject if @p data isn't valid.
+static QJsonObject binaryToJsonObject(const QByteArray &data, bool *ok)
+{
+    QCborParserError error;
+    const QCborValue value = QCborValue::fromCbor(data, &error);
+    *ok = error.error == QCborError::NoError && value.isTag() && value.taggedValue().isMap();
+    return *ok ? binaryToJson(value.taggedValue()).toObject() : QJsonObject();
+}
+#endif
+
+///@brief Parses a layout in any of the LayoutSaver::Format formats
+static bool jsonObjectFromData(const QByteArray &data, QJsonObject &object)
+{
+    if (isBinaryLayout(data)) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+        bool ok = false;
+        object = binaryToJsonObject(data, &ok);
+        return ok;
+#else
+        return false;
+#endif
+    }
+
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError)
+        return false;
+
+    object = doc.object();
+    return true;
+}
+
+LayoutWriter::~LayoutWriter() = default;
+
+void LayoutWriter::writeKey(QLatin1String key)
+{
+    writeKey(QString(key));
+}
+
+void LayoutWriter::writeValue(QRect rect)
+{
+    beginObject();
+    write(Keys::height, rect.height());
+    write(Keys::width, rect.width());
+    write(Keys::x, rect.x());
+    write(Keys::y, rect.y());
+    endObject();
+}
+
+void LayoutWriter::writeValue(QSize size)
+{
+    beginObject();
+    write(Keys::height, size.height());
+    write(Keys::width, size.width());
+    endObject();
+}
+
+void LayoutWriter::writeValue(const QStringList &list)
+{
+    beginArray();
+    for (const QString &str : list)
+        writeValue(str);
+    endArray();
+}
+
+void LayoutWriter::writeValue(const QJsonValue &value)
+{
+    // For the Item trees, which the layouting engine gives us as QJsonObject
+    switch (value.type()) {
+    case QJsonValue::Object: {
+        beginObject();
+        const QJsonObject object = value.toObject();
+        for (auto it = object.constBegin(), end = object.constEnd(); it != end; ++it) {
+            writeKey(it.key());
+            writeValue(it.value());
+        }
+        endObject();
+        break;
+    }
+    case QJsonValue::Array: {
+        beginArray();
+        const QJsonArray array = value.toArray();
+        for (const QJsonValue &v : array)
+            writeValue(v);
+        endArray();
+        break;
+    }
+    case QJsonValue::Bool:
+        writeValue(value.toBool());
+        break;
+    case QJsonValue::Double:
+        writeValue(value.toDouble());
+        break;
+    case QJsonValue::String:
+        writeValue(value.toString());
+        break;
+    case QJsonValue::Null:
+    case QJsonValue::Undefined:
+        writeNull();
+        break;
+    }
+}
+
+JsonWriter::JsonWriter(QIODevice *device)
+    : m_device(device)
+{
+}
+
+void JsonWriter::writeRaw(const QByteArray &data)
+{
+    if (!m_hasError && m_device->write(data) != data.size())
+        m_hasError = true;
+}
+
+void JsonWriter::writeIndent()
+{
+    writeRaw(QByteArray(4 * m_scopes.size(), ' '));
+}
+
+void JsonWriter::beginValue()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+
+    if (!m_scopes.isEmpty()) {
+        Scope &scope = m_scopes.last();
+        writeRaw(scope.count > 0 ? ",\n" : "\n");
+        scope.count++;
+        writeIndent();
+    }
+}
+
+void JsonWriter::beginObject()
+{
+    beginValue();
+    writeRaw("{");
+    m_scopes.push_back({ false, 0 });
+}
+
+void JsonWriter::endObject()
+{
+    const Scope scope = m_scopes.takeLast();
+    if (scope.count > 0) {
+        writeRaw("\n");
+        writeIndent();
+    }
+
+    writeRaw(m_scopes.isEmpty() ? "}\n" : "}");
+}
+
+void JsonWriter::beginArray()
+{
+    beginValue();
+    writeRaw("[");
+    m_scopes.push_back({ true, 0 });
+}
+
+void JsonWriter::endArray()
+{
+    const Scope scope = m_scopes.takeLast();
+    if (scope.count > 0) {
+        writeRaw("\n");
+        writeIndent();
+    }
+
+    writeRaw("]");
+}
+
+void JsonWriter::writeKey(const QString &key)
+{
+    Q_ASSERT(!m_scopes.isEmpty() && !m_scopes.last().isArray);
+    beginValue();
+    writeString(key);
+    writeRaw(": ");
+    m_afterKey = true;
+}
+
+void JsonWriter::writeString(const QString &str)
+{
+    QString escaped;
+    escaped.reserve(str.size() + 2);
+    escaped += QLatin1Char('"');
+    for (const QChar c : str) {
+        switch (c.unicode()) {
+        case '"': escaped += QLatin1String("\\\""); break;
+        case '\\': escaped += QLatin1String("\\\\"); break;
+        case '\b': escaped += QLatin1String("\\b"); break;
+        case '\f': escaped += QLatin1String("\\f"); break;
+        case '\n': escaped += QLatin1String("\\n"); break;
+        case '\r': escaped += QLatin1String("\\r"); break;
+        case '\t': escaped += QLatin1String("\\t"); break;
+        default:
+            if (c.unicode() < 0x20)
+                escaped += QStringLiteral("\\u%1").arg(c.unicode(), 4, 16, QLatin1Char('0'));
+            else
+                escaped += c;
+        }
+    }
+    escaped += QLatin1Char('"');
+
+    writeRaw(escaped.toUtf8());
+}
+
+void JsonWriter::writeNull()
+{
+    beginValue();
+    writeRaw("null");
+}
+
+void JsonWriter::writeValue(int value)
+{
+    beginValue();
+    writeRaw(QByteArray::number(value));
+}
+
+void JsonWriter::writeValue(bool value)
+{
+    beginValue();
+    writeRaw(value ? "true" : "false");
+}
+
+void JsonWriter::writeValue(double value)
+{
+    beginValue();
+    if (qIsFinite(value))
+        writeRaw(QByteArray::number(value, 'g', QLocale::FloatingPointShortest));
+    else
+        writeRaw("null"); // Same as QJsonDocument
+}
+
+void JsonWriter::writeValue(const QString &value)
+{
+    beginValue();
+    writeString(value);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+CborWriter::CborWriter(QByteArray *data)
+    : m_writer(data)
+{
+    // Tells binary layouts apart from JSON, see isBinaryLayout()
+    m_writer.append(QCborKnownTags::Signature);
+}
+
+void CborWriter::beginObject()
+{
+    m_writer.startMap();
+}
+
+void CborWriter::endObject()
+{
+    m_writer.endMap();
+}
+
+void CborWriter::beginArray()
+{
+    m_writer.startArray();
+}
+
+void CborWriter::endArray()
+{
+    m_writer.endArray();
+}
+
+void CborWriter::writeKey(const QString &key)
+{
+    const int tag = binaryTagForKey(key);
+    if (tag == -1)
+        m_writer.append(key); // Frame ids, for example
+    else
+        m_writer.append(qint64(tag));
+}
+
+void CborWriter::writeKey(QLatin1String key)
+{
+    const int tag = binaryTagForKey(key);
+    if (tag == -1)
+        m_writer.append(key);
+    else
+        m_writer.append(qint64(tag));
+}
+
+void CborWriter::writeNull()
+{
+    m_writer.append(nullptr);
+}
+
+void CborWriter::writeValue(int value)
+{
+    m_writer.append(qint64(value));
+}
+
+void CborWriter::writeValue(bool value)
+{
+    m_writer.append(value);
+}
+
+void CborWriter::writeValue(double value)
+{
+    // JSON doesn't tell integers and doubles apart, so integral doubles are stored as integers.
+    // Keeps conversions between both formats lossless.
+    if (std::floor(value) == value && std::abs(value) < 9007199254740992.0) // 2^53
+        m_writer.append(qint64(value));
+    else
+        m_writer.append(value);
+}
+
+void CborWriter::writeValue(const QString &value)
+{
+    m_writer.append(value);
+}
+#endif
+
+LayoutSaver::LayoutSaver(RestoreOptions options)
+    : d(new Private(options))
+{
+}
+
+LayoutSaver::~LayoutSaver()
+{
+    delete d;
+}
+
+bool LayoutSaver::saveToFile(const QString &jsonFilename)
+{
+    LayoutSaver::Layout layout;
+    if (!d->collectLayout(layout))
+        return false;
+
+    QFile f(jsonFilename);
+    if (!f.open(QIODevice::WriteOnly)) {
+        qWarning() << Q_FUNC_INFO << "Failed to open" << jsonFilename << f.errorString();
+        return false;
+    }
+
+    // JSON is streamed straight into the file, no intermediate QVariantMap or QByteArray
+    const bool ok = d->m_format == Format::Binary ? f.write(layout.toBinary()) != -1
+                                                  : layout.writeJson(&f);
+    if (!ok) {
+        qWarning() << Q_FUNC_INFO << "Failed to write" << jsonFilename << f.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool LayoutSaver::restoreFromFile(const QString &jsonFilename)
+{
+    QFile f(jsonFilename);
+    if (!f.open(QIODevice::ReadOnly)) {
+        qWarning() << Q_FUNC_INFO << "Failed to open" << jsonFilename << f.errorString();
+        return false;
+    }
+
+    const QByteArray data = f.readAll();
+    const bool result = restoreLayout(data);
+
+    return result;
+}
+
+QByteArray LayoutSaver::serializeLayout() const
+{
+    LayoutSaver::Layout layout;
+    if (!d->collectLayout(layout))
+        return {};
+
+    return d->m_format == Format::Binary ? layout.toBinary()
+                                         : layout.toJson();
+}
+
+bool LayoutSaver::Private::collectLayout(LayoutSaver::Layout &layout) const
+{
+    if (s_restoreInProgress) {
+        // The layout is only partially restored, plus serializing would clobber the shared DockWidget info
+        qWarning() << Q_FUNC_INFO << "Refusing to serialize while a restore is in progress";
+        return false;
+    }
+
+    LayoutCollector collector(*this, layout);
+    if (!collector.begin())
+        return false;
+
+    while (!collector.isDone())
+        collector.step();
+
+    return true;
+}
+
+LayoutSaver::Private::LayoutCollector::LayoutCollector(const Private &saver, LayoutSaver::Layout &layout)
+    : d(saver)
+    , layout(layout)
+{
+}
+
+bool LayoutSaver::Private::LayoutCollector::begin()
+{
+    DockRegistry *registry = d.m_dockRegistry;
+    if (!registry->isSane()) {
+        qWarning() << Q_FUNC_INFO << "Refusing to serialize this layout. Check previous warnings.";
+        return false;
+    }
+
+    // Just a simplification. One less type of windows to handle.
+    registry->ensureAllFloatingWidgetsAreMorphed();
+
+    for (MainWindowBase *mainWindow : registry->mainwindows()) {
+        if (d.matchesAffinity(mainWindow->affinitySet()))
+            mainWindows.push_back(mainWindow);
+    }
+
+    for (KDDockWidgets::FloatingWindow *floatingWindow : registry->nestedwindows()) {
+        if (d.matchesAffinity(floatingWindow->affinitySet()))
+            floatingWindows.push_back(floatingWindow);
+    }
+
+    // Closed dock widgets also have interesting things to save, like geometry and placeholder info
+    for (DockWidgetBase *dockWidget : registry->closedDockwidgets()) {
+        if (d.matchesAffinity(dockWidget->affinitySet()))
+            closedDockWidgets.push_back(dockWidget);
+    }
+
+    // Save the placeholder info. We do it last, as we also restore it last, since we need all items to be created
+    // before restoring the placeholders
+    for (DockWidgetBase *dockWidget : registry->dockwidgets()) {
+        if (d.matchesAffinity(dockWidget->affinitySet()))
+            dockWidgets.push_back(dockWidget);
+    }
+
+    layout.mainWindows.reserve(mainWindows.size());
+    layout.floatingWindows.reserve(floatingWindows.size());
+    layout.closedDockWidgets.reserve(closedDockWidgets.size());
+    layout.allDockWidgets.reserve(dockWidgets.size());
+
+    return true;
+}
+
+int LayoutSaver::Private::LayoutCollector::numSteps() const
+{
+    return mainWindows.size() + floatingWindows.size() + closedDockWidgets.size() + dockWidgets.size();
+}
+
+void LayoutSaver::Private::LayoutCollector::step()
+{
+    // Windows and dock widgets deleted since begin() are skipped, if we're time sliced
+    int i = index++;
+    if (i < mainWindows.size()) {
+        if (MainWindowBase *mainWindow = mainWindows.at(i))
+            layout.mainWindows.push_back(mainWindow->serialize());
+        return;
+    }
+
+    i -= mainWindows.size();
+    if (i < floatingWindows.size()) {
+        if (KDDockWidgets::FloatingWindow *floatingWindow = floatingWindows.at(i))
+            layout.floatingWindows.push_back(floatingWindow->serialize());
+        return;
+    }
+
+    i -= floatingWindows.size();
+    if (i < closedDockWidgets.size()) {
+        if (DockWidgetBase *dockWidget = closedDockWidgets.at(i))
+            layout.closedDockWidgets.push_back(dockWidget->serialize());
+        return;
+    }
+
+    i -= closedDockWidgets.size();
+    if (i < dockWidgets.size()) {
+        if (DockWidgetBase *dockWidget = dockWidgets.at(i)) {
+            auto dw = dockWidget->serialize();
+            dw->lastPosition = dockWidget->lastPositions().serialize();
+            layout.allDockWidgets.push_back(dw);
+        }
+    }
+}
+
+void LayoutSaver::setFormat(Format format)
+{
+    d->m_format = format;
+}
+
+LayoutSaver::Format LayoutSaver::format() const
+{
+    return d->m_format;
+}
+
+QByteArray LayoutSaver::convertLayout(const QByteArray &data, Format format)
+{
+    // Converted value by value. Loading it into a Layout would create the DockWidget structs it names.
+    QJsonObject object;
+    if (!jsonObjectFromData(data, object)) {
+        qWarning() << Q_FUNC_INFO << "Failed to parse layout";
+        return {};
+    }
+
+    if (format == Format::Json)
+        return QJsonDocument(object).toJson();
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    QByteArray result;
+    CborWriter writer(&result);
+    writer.writeValue(QJsonValue(object));
+    return result;
+#else
+    qWarning() << Q_FUNC_INFO << "Binary layouts need Qt 5.12, saving as JSON instead";
+    return QJsonDocument(object).toJson();
+#endif
+}
+
+bool LayoutSaver::restoreLayout(const QByteArray &data)
+{
+    if (restoreInProgress()) {
+        qWarning() << Q_FUNC_INFO << "A restore is already in progress";
+        return false;
+    }
+
+    d->clearRestoredProperty();
+    if (data.isEmpty())
+        return true;
+
+    Private::RestoreJob job(*d, data);
+    while (!job.isDone()) {
+        if (!job.step())
+            return false;
+    }
+
+    return true;
+}
+
+AsyncLayoutRestore *LayoutSaver::restoreLayoutAsync(const QByteArray &data)
+{
+    if (restoreInProgress()) {
+        qWarning() << Q_FUNC_INFO << "A restore is already in progress";
+        return nullptr;
+    }
+
+    d->clearRestoredProperty();
+    return new AsyncLayoutRestore(*this, data);
+}
+
+///@brief Fills @p paths with the path from the root of each frame in the saved item tree @p item
+///@sa Layouting::Item::pathFromRoot()
+static void collectFramePaths(const QJsonObject &item, QVector<int> &path, QHash<QString, QVector<int>> &paths)
+{
+    if (!item.value(Keys::isContainer).toBool()) {
+        const QString guestId = item.value(Keys::guestId).toString();
+        if (!guestId.isEmpty())
+            paths.insert(guestId, path);
+        return;
+    }
+
+    const QJsonArray children = item.value(Keys::children).toArray();
+    for (int i = 0; i < children.size(); ++i) {
+        path.push_back(i);
+        collectFramePaths(children.at(i).toObject(), path, paths);
+        path.pop_back();
+    }
+}
+
+///@brief Returns whether @p frame has exactly the dock widgets @p dockWidgets, in the same order
+static bool frameHasDockWidgets(KDDockWidgets::Frame *frame, const LayoutSaver::DockWidget::List &dockWidgets)
+{
+    const DockWidgetBase::List current = frame->dockWidgets();
+    if (current.size() != dockWidgets.size())
+        return false;
+
+    for (int i = 0; i < current.size(); ++i) {
+        if (current.at(i)->uniqueName() != dockWidgets.at(i)->uniqueName)
+            return false;
+    }
+
+    return true;
+}
+
+LayoutSaver::Private::RestoreJob::RestoreJob(const Private &saver, const QByteArray &jsonData)
+    : d(saver)
+    , data(jsonData)
+{
+}
+
+LayoutSaver::Private::RestoreJob::~RestoreJob()
+{
+    clearJob.reset(); // Finishes clearing, if we were interrupted in the middle of it
+
+    for (const QPointer<Layouting::Item> &item : qAsConst(pinnedItems)) {
+        if (item)
+            item->unref();
+    }
+
+    d.deleteEmptyFrames();
+}
+
+int LayoutSaver::Private::RestoreJob::numSteps() const
+{
+    // Parsing, clearing, plus one step per window and dock widget
+    return 1 + numMatchSteps() + numClearSteps + layout.mainWindows.size() + layout.floatingWindows.size()
+            + layout.closedDockWidgets.size() + layout.allDockWidgets.size();
+}
+
+int LayoutSaver::Private::RestoreJob::numMatchSteps() const
+{
+    // With RestoreOption_Incremental each saved window is first matched against the current ones
+    return (d.m_restoreOptions & RestoreOption_Incremental) ? layout.mainWindows.size() + layout.floatingWindows.size()
+                                                            : 0;
+}
+
+void LayoutSaver::Private::RestoreJob::nextPhase(Phase next)
+{
+    phase = next;
+    index = 0;
+}
+
+bool LayoutSaver::Private::RestoreJob::step()
+{
+    switch (phase) {
+    case Phase::Parse:
+        if (!layout.fromData(data)) {
+            qWarning() << Q_FUNC_INFO << "Failed to parse layout data";
+            return false;
+        }
+
+        if (!layout.isValid())
+            return false;
+
+        if (d.m_restoreOptions & RestoreOption_RelativeToMainWindow)
+            layout.scaleSizes();
+
+        numClearSteps = layout.dockWidgetNames().size() + 1; // Estimate, until we know what's cleared
+        nextPhase(Phase::Clear);
+        break;
+    case Phase::Clear:
+        if (index < numMatchSteps()) {
+            if (index < layout.mainWindows.size())
+                matchMainWindow(layout.mainWindows.at(index));
+            else
+                matchFloatingWindow(index - layout.mainWindows.size());
+            index++;
+        } else {
+            clearStep();
+            if (!clearJob)
+                nextPhase(Phase::MainWindows);
+        }
+        break;
+    case Phase::MainWindows:
+        if (index < layout.mainWindows.size()) {
+            if (!restoreMainWindow(layout.mainWindows.at(index++)))
+                return false;
+        } else {
+            nextPhase(Phase::FloatingWindows);
+            return step();
+        }
+        break;
+    case Phase::FloatingWindows:
+        if (index < layout.floatingWindows.size()) {
+            if (!restoreFloatingWindow(index++))
+                return false;
+        } else {
+            nextPhase(Phase::ClosedDockWidgets);
+            return step();
+        }
+        break;
+    case Phase::ClosedDockWidgets:
+        // Closed dock widgets remain closed but acquire geometry and placeholder properties
+        if (index < layout.closedDockWidgets.size()) {
+            const auto &dw = layout.closedDockWidgets.at(index++);
+            if (d.matchesAffinity(dw->affinities))
+                DockWidgetBase::deserialize(dw);
+        } else {
+            nextPhase(Phase::Placeholders);
+            return step();
+        }
+        break;
+    case Phase::Placeholders:
+        // Restore the placeholder info, now that the Items have been created
+        if (index < layout.allDockWidgets.size()) {
+            const auto &dw = layout.allDockWidgets.at(index++);
+            if (!d.matchesAffinity(dw->affinities))
+                break;
+
+            if (DockWidgetBase *dockWidget = d.m_dockRegistry->dockByName(dw->uniqueName)) {
+                dockWidget->lastPositions().deserialize(dw->lastPosition);
+            } else {
+                qWarning() << Q_FUNC_INFO << "Couldn't find dock widget" << dw->uniqueName;
+            }
+        } else {
+            nextPhase(Phase::Done);
+            return true;
+        }
+        break;
+    case Phase::Done:
+        return true;
+    }
+
+    stepsDone++;
+    return true;
+}
+
+void LayoutSaver::Private::RestoreJob::matchMainWindow(const LayoutSaver::MainWindow &mw)
+{
+    // With RestoreOption_Incremental, main windows with the same item tree as the saved layout keep their
+    // items, frames and dock widgets, only geometries are restored, see restoreMainWindow().
+    // Their items are pinned while other dock widgets drop their placeholders, so the layout stays intact
+    // until the placeholders are restored.
+    // Otherwise the item tree is rebuilt, but the frames that are still the same are kept, see matchFrames().
+    MainWindowBase *mainWindow = d.m_dockRegistry->mainWindowByName(mw.uniqueName);
+    if (!mainWindow || !d.matchesAffinity(mainWindow->affinitySet()))
+        return;
+
+    if (!d.mainWindowMatches(mainWindow, mw)) {
+        matchFrames(mw.multiSplitterLayout, mainWindow->multiSplitter());
+        return;
+    }
+
+    unchangedMainWindows.push_back(mainWindow);
+    for (Layouting::Item *item : mainWindow->multiSplitter()->items()) {
+        item->ref();
+        pinnedItems.push_back(item);
+    }
+}
+
+void LayoutSaver::Private::RestoreJob::matchFloatingWindow(int index)
+{
+    // A saved floating window is matched with the current one showing its dock widgets, which is then
+    // kept instead of being recreated, see restoreFloatingWindow().
+    const LayoutSaver::FloatingWindow &fw = layout.floatingWindows.at(index);
+    if (!d.matchesAffinity(fw.affinities))
+        return;
+
+    const QStringList dockWidgetNames = layout.dockWidgetNames();
+    KDDockWidgets::FloatingWindow *candidate = nullptr;
+    for (const LayoutSaver::Frame &frame : qAsConst(fw.multiSplitterLayout.frames)) {
+        if (frame.dockWidgets.isEmpty())
+            continue;
+
+        DockWidgetBase *dw = d.m_dockRegistry->dockByName(frame.dockWidgets.first()->uniqueName);
+        KDDockWidgets::Frame *currentFrame = dw ? dw->frame() : nullptr;
+        candidate = currentFrame ? currentFrame->floatingWindow() : nullptr;
+        if (candidate)
+            break;
+    }
+
+    if (!candidate || candidate->beingDeleted())
+        return;
+
+    for (const QPointer<KDDockWidgets::FloatingWindow> &reused : qAsConst(reusedFloatingWindows)) {
+        if (reused == candidate)
+            return;
+    }
+
+    // Dock widgets the layout doesn't know about wouldn't be cleared, and would be left out of the new item tree
+    for (KDDockWidgets::Frame *frame : candidate->frames()) {
+        for (DockWidgetBase *dw : frame->dockWidgets()) {
+            if (!dockWidgetNames.contains(dw->uniqueName()))
+                return;
+        }
+    }
+
+    if (matchFrames(fw.multiSplitterLayout, candidate->multiSplitter()) > 0)
+        reusedFloatingWindows.insert(index, candidate);
+}
+
+int LayoutSaver::Private::RestoreJob::matchFrames(const LayoutSaver::MultiSplitter &saved,
+                                                   KDDockWidgets::MultiSplitter *multiSplitter)
+{
+    // Frames showing dock widgets are matched by them, the ones without (like the persistent central frame)
+    // by their position in the item tree. Matched frames keep their dock widgets, which aren't cleared, and
+    // are put into the rebuilt item tree, see MultiSplitter::deserialize(). The others are created or deleted.
+    const KDDockWidgets::Frame::List currentFrames = multiSplitter->frames();
+    QHash<QString, QVector<int>> savedPaths;
+    int numMatched = 0;
+
+    for (auto it = saved.frames.cbegin(), end = saved.frames.cend(); it != end; ++it) {
+        const LayoutSaver::Frame &savedFrame = *it;
+        KDDockWidgets::Frame *match = nullptr;
+        if (savedFrame.dockWidgets.isEmpty()) {
+            if (savedPaths.isEmpty()) {
+                QVector<int> path;
+                collectFramePaths(saved.layout, path, savedPaths);
+            }
+
+            auto pathIt = savedPaths.constFind(it.key());
+            if (pathIt == savedPaths.constEnd())
+                continue;
+
+            for (KDDockWidgets::Frame *frame : currentFrames) {
+                if (frame->isEmpty() && frame->layoutItem() && frame->layoutItem()->pathFromRoot() == *pathIt) {
+                    match = frame;
+                    break;
+                }
+            }
+        } else if (DockWidgetBase *dw = d.m_dockRegistry->dockByName(savedFrame.dockWidgets.first()->uniqueName)) {
+            KDDockWidgets::Frame *frame = dw->frame();
+            if (frame && currentFrames.contains(frame) && frameHasDockWidgets(frame, savedFrame.dockWidgets))
+                match = frame;
+        }
+
+        if (match && savedFrame.options == unsigned(match->options())) {
+            reusedFrames.insert(it.key(), match);
+            numMatched++;
+        }
+    }
+
+    return numMatched;
+}
+
+QHash<QString, KDDockWidgets::Frame *> LayoutSaver::Private::RestoreJob::reusedFramesFor(const LayoutSaver::MultiSplitter &saved,
+                                                                                        KDDockWidgets::MultiSplitter *multiSplitter) const
+{
+    // An async restore runs in steps, so check the frames weren't closed or moved in the meantime
+    QHash<QString, KDDockWidgets::Frame *> frames;
+    for (auto it = saved.frames.cbegin(), end = saved.frames.cend(); it != end; ++it) {
+        KDDockWidgets::Frame *frame = reusedFrames.value(it.key());
+        if (frame && !frame->beingDeletedLater() && frame->parent() == multiSplitter
+            && frameHasDockWidgets(frame, it->dockWidgets))
+            frames.insert(it.key(), frame);
+    }
+
+    return frames;
+}
+
+void LayoutSaver::Private::RestoreJob::clearStep()
+{
+    if (!clearJob) {
+        DockWidgetBase::List dockWidgetsToClear = d.m_dockRegistry->dockWidgets(layout.dockWidgetNames());
+        MainWindowBase::List mainWindowsToClear = d.m_dockRegistry->mainWindows(layout.mainWindowNames());
+        for (MainWindowBase *mainWindow : qAsConst(unchangedMainWindows)) {
+            if (!mainWindow)
+                continue;
+
+            mainWindowsToClear.removeOne(mainWindow);
+            for (KDDockWidgets::Frame *frame : mainWindow->multiSplitter()->frames()) {
+                for (DockWidgetBase *dw : frame->dockWidgets())
+                    dockWidgetsToClear.removeOne(dw);
+            }
+        }
+
+        // Reused frames keep their dock widgets. Their items are still cleared, the frames aren't owned by them,
+        // and the saved placeholders replace the current ones, like for the cleared dock widgets.
+        for (const QPointer<KDDockWidgets::Frame> &frame : qAsConst(reusedFrames)) {
+            if (!frame)
+                continue;
+
+            for (DockWidgetBase *dw : frame->dockWidgets()) {
+                dockWidgetsToClear.removeOne(dw);
+                dw->lastPositions().removePlaceholders();
+            }
+        }
+
+        // Hide all dockwidgets and unparent them from any layout before starting restore
+        // We only close the stuff that the loaded JSON knows about. Unknown widgets might be newer.
+        // One dock widget per step, so async restores don't block on closing them all.
+        clearJob.reset(new DockRegistry::ClearJob(dockWidgetsToClear, mainWindowsToClear, d.m_affinityNames));
+        numClearSteps = clearJob->numSteps();
+    }
+
+    clearJob->step();
+    if (clearJob->isDone())
+        clearJob.reset();
+}
+
+bool LayoutSaver::Private::RestoreJob::restoreMainWindow(const LayoutSaver::MainWindow &mw)
+{
+    MainWindowBase *mainWindow = d.m_dockRegistry->mainWindowByName(mw.uniqueName);
+    if (!mainWindow ) {
+        if (auto mwFunc = Config::self().mainWindowFactoryFunc()) {
+            mainWindow = mwFunc(mw.uniqueName);
+        } else {
+            qWarning() << "Failed to restore layout create MainWindow with name" << mw.uniqueName << "first";
+            return false;
+        }
+    }
+
+    if (!d.matchesAffinity(mainWindow->affinitySet()))
+        return true;
+
+    if (!(d.m_restoreOptions & RestoreOption_RelativeToMainWindow))
+        d.deserializeWindowGeometry(mw, mainWindow->window()); // window(), as the MainWindow can be embedded
+
+    if (unchangedMainWindows.contains(mainWindow)) {
+        // Same items, only their geometries can differ. Those are applied in place.
+        for (KDDockWidgets::Frame *frame : mainWindow->multiSplitter()->frames()) {
+            for (DockWidgetBase *dw : frame->dockWidgets())
+                dw->setProperty("kddockwidget_was_restored", true);
+        }
+        return mainWindow->multiSplitter()->restoreGeometries(mw.multiSplitterLayout);
+    }
+
+    return mainWindow->deserialize(mw, reusedFramesFor(mw.multiSplitterLayout, mainWindow->multiSplitter()));
+}
+
+bool LayoutSaver::Private::RestoreJob::restoreFloatingWindow(int index)
+{
+    const LayoutSaver::FloatingWindow &fw = layout.floatingWindows.at(index);
+    if (!d.matchesAffinity(fw.affinities))
+        return true;
+
+    KDDockWidgets::FloatingWindow *floatingWindow = reusedFloatingWindows.value(index);
+    QHash<QString, KDDockWidgets::Frame *> frames;
+    if (floatingWindow && !floatingWindow->beingDeleted())
+        frames = reusedFramesFor(fw.multiSplitterLayout, floatingWindow->multiSplitter());
+
+    if (frames.isEmpty()) {
+        MainWindowBase *parent = fw.parentIndex == -1 ? nullptr
+                                                      : DockRegistry::self()->mainwindows().at(fw.parentIndex);
+
+        floatingWindow = Config::self().frameworkWidgetFactory()->createFloatingWindow(parent);
+    } else {
+        // Placeholders refer to floating windows by their index in the registry, which follows the
+        // saved order for the created ones. Move this one to the end too. Registering before
+        // unregistering, as removeOne() drops the first occurrence.
+        d.m_dockRegistry->registerNestedWindow(floatingWindow);
+        d.m_dockRegistry->unregisterNestedWindow(floatingWindow);
+    }
+
+    d.deserializeWindowGeometry(fw, floatingWindow);
+    if (!floatingWindow->deserialize(fw, frames)) {
+        qWarning() << Q_FUNC_INFO << "Failed to deserialize floating window";
+        return false;
+    }
+
+    return true;
+}
+
+///@brief Replaces the DockWidget instances shared through DockWidget::s_dockWidgets with private copies,
+///so @p layout can be read by another thread while the GUI thread saves or restores again.
+///The frames already have their own copies, see MultiSplitter::serialize().
+static void detachDockWidgets(LayoutSaver::Layout &layout)
+{
+    QHash<QString, LayoutSaver::DockWidget::Ptr> copies;
+    auto copyOf = [&copies] (const LayoutSaver::DockWidget::Ptr &dw) {
+        LayoutSaver::DockWidget::Ptr &copy = copies[dw->uniqueName];
+        if (!copy)
+            copy = std::make_shared<LayoutSaver::DockWidget>(*dw);
+        return copy;
+    };
+
+    for (LayoutSaver::DockWidget::Ptr &dw : layout.allDockWidgets)
+        dw = copyOf(dw);
+    for (LayoutSaver::DockWidget::Ptr &dw : layout.closedDockWidgets)
+        dw = copyOf(dw);
+}
+
+class AsyncLayoutRestore::Private
+{
+public:
+    Private(const LayoutSaver::Private &saver, const QByteArray &data)
+        : m_saver(saver)
+        , m_data(data)
+        , m_isRestoring(new LayoutSaver::Private::RAIIIsRestoring())
+    {
+    }
+
+    const LayoutSaver::Private m_saver;
+    const QByteArray m_data;
+
+    // Set until m_job exists, so no other restore starts while we collect the rollback layout
+    std::unique_ptr<LayoutSaver::Private::RAIIIsRestoring> m_isRestoring;
+
+    // The layout we had before, for cancel(). Collected in time slices too, before the restore starts.
+    LayoutSaver::Layout m_previousLayout;
+    std::unique_ptr<LayoutSaver::Private::LayoutCollector> m_collector;
+    bool m_hasPreviousLayout = false;
+
+    std::unique_ptr<LayoutSaver::Private::RestoreJob> m_job;
+    int m_timeBudget = 10;
+    bool m_finished = false;
+};
+
+AsyncLayoutRestore::AsyncLayoutRestore(const LayoutSaver &saver, const QByteArray &data)
+    : QObject()
+    , d(new Private(*saver.d, data))
+{
+    d->m_collector.reset(new LayoutSaver::Private::LayoutCollector(d->m_saver, d->m_previousLayout));
+    if (!d->m_collector->begin())
+        d->m_collector.reset(); // Nothing to go back to, cancel() will just stop
+
+    QTimer::singleShot(0, this, &AsyncLayoutRestore::processSteps);
+}
+
+AsyncLayoutRestore::~AsyncLayoutRestore()
+{
+    delete d;
+}
+
+void AsyncLayoutRestore::setTimeBudget(int milliseconds)
+{
+    d->m_timeBudget = qMax(1, milliseconds);
+}
+
+int AsyncLayoutRestore::timeBudget() const
+{
+    return d->m_timeBudget;
+}
+
+double AsyncLayoutRestore::progress() const
+{
+    if (d->m_finished)
+        return 1.0;
+
+    const LayoutSaver::Private::RestoreJob *job = d->m_job.get();
+    if (!job || job->phase == LayoutSaver::Private::RestoreJob::Phase::Parse)
+        return 0.0; // We don't know the number of steps yet
+
+    // numSteps() is an estimate until the clear phase starts
+    return qMin(1.0, double(job->stepsDone) / job->numSteps());
+}
+
+bool AsyncLayoutRestore::isFinished() const
+{
+    return d->m_finished;
+}
+
+void AsyncLayoutRestore::cancel()
+{
+    if (d->m_finished)
+        return;
+
+    // Ends the restore, then rebuild what we had before. Nothing changed if it didn't start yet.
+    const bool restoreStarted = d->m_job != nullptr;
+    d->m_collector.reset();
+    d->m_job.reset();
+    d->m_isRestoring.reset();
+
+    if (restoreStarted && d->m_hasPreviousLayout) {
+        LayoutSaver rollback;
+        rollback.setAffinityNames(d->m_saver.m_affinityNames);
+        if (!rollback.restoreLayout(d->m_previousLayout.toJson()))
+            qWarning() << Q_FUNC_INFO << "Failed to restore the previous layout";
+    }
+
+    finish(false);
+}
+
+bool AsyncLayoutRestore::step()
+{
+    if (d->m_collector) {
+        if (d->m_collector->isDone()) {
+            d->m_collector.reset();
+            // The restore reuses the shared DockWidget instances, so keep our own copies
+            detachDockWidgets(d->m_previousLayout);
+            d->m_hasPreviousLayout = true;
+        } else {
+            d->m_collector->step();
+        }
+        return true;
+    }
+
+    if (!d->m_job) {
+        d->m_isRestoring.reset(); // The job sets it again
+        d->m_job.reset(new LayoutSaver::Private::RestoreJob(d->m_saver, d->m_data));
+    }
+
+    return d->m_job->step();
+}
+
+void AsyncLayoutRestore::processSteps()
+{
+    if (d->m_finished)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    auto isDone = [this] { return d->m_job && d->m_job->isDone(); };
+    while (!isDone() && !timer.hasExpired(d->m_timeBudget)) {
+        if (!step()) {
+            d->m_job.reset();
+            finish(false);
+            return;
+        }
+    }
+
+    Q_EMIT progressChanged(progress());
+    if (d->m_finished) // cancelled by a slot
+        return;
+
+    if (isDone()) {
+        d->m_job.reset();
+        finish(true);
+    } else {
+        QTimer::singleShot(0, this, &AsyncLayoutRestore::processSteps);
+    }
+}
+
+void AsyncLayoutRestore::finish(bool success)
+{
+    d->m_finished = true;
+    Q_EMIT finished(success);
+    deleteLater();
+}
+
+class LayoutAutoSaver::Private
+{
+public:
+    struct WriteResult
+    {
+        bool success = false;
+        bool fileWritten = false;
+    };
+
+    ///@brief Posted by the worker thread to m_receiver once a write is done
+    class WriteFinishedEvent : public QEvent
+    {
+    public:
+        WriteFinishedEvent(int generation, WriteResult result)
+            : QEvent(eventType())
+            , generation(generation)
+            , result(result)
+        {
+        }
+
+        static QEvent::Type eventType()
+        {
+            static const int s_type = QEvent::registerEventType();
+            return QEvent::Type(s_type);
+        }
+
+        const int generation;
+        const WriteResult result;
+    };
+
+    ///@brief Lives in the GUI thread and hands the worker's results to Private
+    class Receiver : public QObject
+    {
+    public:
+        explicit Receiver(Private *d)
+            : m_d(d)
+        {
+        }
+
+    protected:
+        void customEvent(QEvent *e) override
+        {
+            if (e->type() == WriteFinishedEvent::eventType()) {
+                auto ev = static_cast<WriteFinishedEvent*>(e);
+                m_d->onWriteFinished(ev->generation, ev->result);
+            }
+        }
+
+    private:
+        Private *const m_d;
+    };
+
+    class WriteTask : public QRunnable
+    {
+    public:
+        WriteTask(Private *d, const LayoutSaver::Layout &layout, int generation)
+            : m_receiver(&d->m_receiver)
+            , m_layout(layout)
+            , m_filename(d->m_filename)
+            , m_format(d->m_saver.format())
+            , m_generation(generation)
+        {
         }
-        Q_DISABLE_COPY(RAIIIsRestoring)
+
+        void run() override;
+
+    private:
+        QObject *const m_receiver;
+        const LayoutSaver::Layout &m_layout; // Owned by Private::m_snapshot until we're done
+        const QString m_filename;
+        const LayoutSaver::Format m_format;
+        const int m_generation;
     };
 
-    Private(RestoreOptions options)
-        : m_dockRegistry(DockRegistry::self())
-        , m_restoreOptions(options)
+    Private(LayoutAutoSaver *qq, const QString &filename)
+        : q(qq)
+        , m_filename(filename)
+        , m_receiver(this)
     {
+        m_debounceTimer.setSingleShot(true);
+        m_debounceTimer.setInterval(500);
+        m_pool.setMaxThreadCount(1);
     }
 
-    bool matchesAffinity(const QStringList &affinities) const {
-        return m_affinityNames.isEmpty() || affinities.isEmpty() || DockRegistry::self()->affinitiesMatch(m_affinityNames, affinities);
-    }
+    void onWriteFinished(int generation, WriteResult result);
 
-    template <typename T>
-    void deserializeWindowGeometry(const T &saved, QWidgetOrQuick *topLevel);
-    void deleteEmptyFrames();
-    void clearRestoredProperty();
+    LayoutAutoSaver *const q;
+    const QString m_filename;
+    LayoutSaver m_saver;
+    QTimer m_debounceTimer;
+    QTimer m_intervalTimer;
+    Receiver m_receiver;
 
-    std::unique_ptr<QSettings> settings() const;
-    DockRegistry *const m_dockRegistry;
-    const RestoreOptions m_restoreOptions;
-    QStringList m_affinityNames;
+    // The layout being written. Also destroyed on the GUI thread, as it's created there.
+    std::unique_ptr<LayoutSaver::Layout> m_snapshot;
+    // The last layout written, and in which format. A save that would write the same is skipped.
+    std::unique_ptr<LayoutSaver::Layout> m_lastWritten;
+    LayoutSaver::Format m_lastWrittenFormat = LayoutSaver::Format::Json;
+    int m_generation = 0;
+    bool m_saveAgain = false;
 
-    static bool s_restoreInProgress;
+    QThreadPool m_pool;
 };
 
-bool LayoutSaver::Private::s_restoreInProgress = false;
-
-
-static QVariantList stringListToVariant(const QStringList &strs)
+void LayoutAutoSaver::Private::WriteTask::run()
 {
-    QVariantList variantList;
-    variantList.reserve(strs.size());
-    for (const QString &str : strs)
-        variantList.push_back(str);
+    // Runs in the worker thread. Only touches the snapshot and our own copies.
+    const QByteArray data = m_format == LayoutSaver::Format::Binary ? m_layout.toBinary()
+                                                                    : m_layout.toJson();
+    WriteResult result;
+    if (data.isEmpty()) {
+        qWarning() << Q_FUNC_INFO << "Failed to encode layout";
+    } else {
+        QSaveFile f(m_filename);
+        result.success = f.open(QIODevice::WriteOnly) && f.write(data) == data.size() && f.commit();
+        result.fileWritten = result.success;
+        if (!result.success)
+            qWarning() << Q_FUNC_INFO << "Failed to write" << m_filename << f.errorString();
+    }
 
-    return variantList;
+    QCoreApplication::postEvent(m_receiver, new WriteFinishedEvent(m_generation, result));
 }
 
-static QStringList variantToStringList(const QVariantList &variantList)
+void LayoutAutoSaver::Private::onWriteFinished(int generation, WriteResult result)
 {
-    QStringList stringList;
-    stringList.reserve(variantList.size());
-    for (const QVariant &variant : variantList)
-        stringList.push_back(variant.toString());
+    if (generation != m_generation || !m_snapshot)
+        return;
 
-    return stringList;
+    if (result.success) {
+        m_lastWritten = std::move(m_snapshot);
+        m_lastWrittenFormat = m_saver.format();
+    } else {
+        m_snapshot.reset();
+    }
+
+    Q_EMIT q->saveFinished(result.success, result.fileWritten);
+
+    if (m_saveAgain) {
+        m_saveAgain = false;
+        q->saveNow();
+    }
 }
 
-LayoutSaver::LayoutSaver(RestoreOptions options)
-    : d(new Private(options))
+LayoutAutoSaver::LayoutAutoSaver(const QString &filename, QObject *parent)
+    : QObject(parent)
+    , d(new Private(this, filename))
 {
+    connect(&d->m_debounceTimer, &QTimer::timeout, this, &LayoutAutoSaver::saveNow);
+    connect(&d->m_intervalTimer, &QTimer::timeout, this, &LayoutAutoSaver::saveNow);
 }
 
-LayoutSaver::~LayoutSaver()
+LayoutAutoSaver::~LayoutAutoSaver()
 {
+    d->m_pool.waitForDone();
     delete d;
 }
 
-bool LayoutSaver::saveToFile(const QString &jsonFilename)
+QString LayoutAutoSaver::fileName() const
 {
-    const QByteArray data = serializeLayout();
-
-    QFile f(jsonFilename);
-    if (!f.open(QIODevice::WriteOnly)) {
-        qWarning() << Q_FUNC_INFO << "Failed to open" << jsonFilename << f.errorString();
-        return false;
-    }
-
-    f.write(data);
-    return true;
+    return d->m_filename;
 }
 
-bool LayoutSaver::restoreFromFile(const QString &jsonFilename)
+void LayoutAutoSaver::setFormat(LayoutSaver::Format format)
 {
-    QFile f(jsonFilename);
-    if (!f.open(QIODevice::ReadOnly)) {
-        qWarning() << Q_FUNC_INFO << "Failed to open" << jsonFilename << f.errorString();
-        return false;
-    }
-
-    const QByteArray data = f.readAll();
-    const bool result = restoreLayout(data);
-
-    return result;
+    d->m_saver.setFormat(format);
 }
 
-QByteArray LayoutSaver::serializeLayout() const
+LayoutSaver::Format LayoutAutoSaver::format() const
 {
-    if (!d->m_dockRegistry->isSane()) {
-        qWarning() << Q_FUNC_INFO << "Refusing to serialize this layout. Check previous warnings.";
-        return {};
-    }
-
-    LayoutSaver::Layout layout;
-
-    // Just a simplification. One less type of windows to handle.
-    d->m_dockRegistry->ensureAllFloatingWidgetsAreMorphed();
-
-    const MainWindowBase::List mainWindows = d->m_dockRegistry->mainwindows();
-    layout.mainWindows.reserve(mainWindows.size());
-    for (MainWindowBase *mainWindow : mainWindows) {
-        if (d->matchesAffinity(mainWindow->affinities()))
-            layout.mainWindows.push_back(mainWindow->serialize());
-    }
+    return d->m_saver.format();
+}
 
-    const QVector<KDDockWidgets::FloatingWindow*> floatingWindows = d->m_dockRegistry->nestedwindows();
-    layout.floatingWindows.reserve(floatingWindows.size());
-    for (KDDockWidgets::FloatingWindow *floatingWindow : floatingWindows) {
-        if (d->matchesAffinity(floatingWindow->affinities()))
-            layout.floatingWindows.push_back(floatingWindow->serialize());
-    }
+void LayoutAutoSaver::setAffinityNames(const QStringList &affinityNames)
+{
+    d->m_saver.setAffinityNames(affinityNames);
+}
 
-    // Closed dock widgets also have interesting things to save, like geometry and placeholder info
-    const DockWidgetBase::List closedDockWidgets = d->m_dockRegistry->closedDockwidgets();
-    layout.closedDockWidgets.reserve(closedDockWidgets.size());
-    for (DockWidgetBase *dockWidget : closedDockWidgets) {
-        if (d->matchesAffinity(dockWidget->affinities()))
-            layout.closedDockWidgets.push_back(dockWidget->serialize());
-    }
+void LayoutAutoSaver::setDebounceInterval(int milliseconds)
+{
+    d->m_debounceTimer.setInterval(qMax(0, milliseconds));
+}
 
-    // Save the placeholder info. We do it last, as we also restore it last, since we need all items to be created
-    // before restoring the placeholders
+int LayoutAutoSaver::debounceInterval() const
+{
+    return d->m_debounceTimer.interval();
+}
 
-    const DockWidgetBase::List dockWidgets = d->m_dockRegistry->dockwidgets();
-    layout.allDockWidgets.reserve(dockWidgets.size());
-    for (DockWidgetBase *dockWidget : dockWidgets) {
-        if (d->matchesAffinity(dockWidget->affinities())) {
-            auto dw = dockWidget->serialize();
-            dw->lastPosition = dockWidget->lastPositions().serialize();
-            layout.allDockWidgets.push_back(dw);
-        }
+void LayoutAutoSaver::setInterval(int milliseconds)
+{
+    if (milliseconds > 0) {
+        d->m_intervalTimer.start(milliseconds);
+    } else {
+        d->m_intervalTimer.stop();
     }
-
-    return layout.toJson();
 }
 
-bool LayoutSaver::restoreLayout(const QByteArray &data)
+int LayoutAutoSaver::interval() const
 {
-    d->clearRestoredProperty();
-    if (data.isEmpty())
-        return true;
-
-    Private::RAIIIsRestoring isRestoring;
-
-    struct FrameCleanup {
-        FrameCleanup(LayoutSaver *saver)
-            : m_saver(saver)
-        {
-        }
-
-        ~FrameCleanup()
-        {
-            m_saver->d->deleteEmptyFrames();
-        }
+    return d->m_intervalTimer.isActive() ? d->m_intervalTimer.interval() : 0;
+}
 
-        LayoutSaver *const m_saver;
-    };
+void LayoutAutoSaver::scheduleSave()
+{
+    d->m_debounceTimer.start();
+}
 
-    FrameCleanup cleanup(this);
-    LayoutSaver::Layout layout;
-    if (!layout.fromJson(data)) {
-        qWarning() << Q_FUNC_INFO << "Failed to parse json data";
-        return false;
-    }
+void LayoutAutoSaver::saveNow()
+{
+    d->m_debounceTimer.stop();
 
-    if (!layout.isValid()) {
-        return false;
+    if (d->m_snapshot) {
+        // Still writing the previous one. Save again once it's done, with the newest layout.
+        d->m_saveAgain = true;
+        return;
     }
 
-    if (d->m_restoreOptions & RestoreOption_RelativeToMainWindow)
-        layout.scaleSizes();
-
-    // Hide all dockwidgets and unparent them from any layout before starting restore
-    // We only close the stuff that the loaded JSON knows about. Unknown widgets might be newer.
-    d->m_dockRegistry->clear(d->m_dockRegistry->dockWidgets(layout.dockWidgetNames()),
-                             d->m_dockRegistry->mainWindows(layout.mainWindowNames()),
-                             d->m_affinityNames);
-
-    // 1. Restore main windows
-    for (const LayoutSaver::MainWindow &mw : qAsConst(layout.mainWindows)) {
-        MainWindowBase *mainWindow = d->m_dockRegistry->mainWindowByName(mw.uniqueName);
-        if (!mainWindow ) {
-            if (auto mwFunc = Config::self().mainWindowFactoryFunc()) {
-                mainWindow = mwFunc(mw.uniqueName);
-            } else {
-                qWarning() << "Failed to restore layout create MainWindow with name" << mw.uniqueName << "first";
-                return false;
-            }
-        }
-
-        if (!d->matchesAffinity(mainWindow->affinities()))
-            continue;
-
-        if (!(d->m_restoreOptions & RestoreOption_RelativeToMainWindow))
-            d->deserializeWindowGeometry(mw, mainWindow->window()); // window(), as the MainWindow can be embedded
-
-        if (!mainWindow->deserialize(mw))
-            return false;
+    if (LayoutSaver::restoreInProgress()) {
+        // Can't capture a half restored layout. Try again a bit later.
+        d->m_debounceTimer.start();
+        return;
     }
 
-    // 2. Restore FloatingWindows
-    for (const LayoutSaver::FloatingWindow &fw : qAsConst(layout.floatingWindows)) {
-        if (!d->matchesAffinity(fw.affinities))
-            continue;
-
-        MainWindowBase *parent = fw.parentIndex == -1 ? nullptr
-                                                      : DockRegistry::self()->mainwindows().at(fw.parentIndex);
-
-        auto floatingWindow = Config::self().frameworkWidgetFactory()->createFloatingWindow(parent);
-        d->deserializeWindowGeometry(fw, floatingWindow);
-        if (!floatingWindow->deserialize(fw)) {
-            qWarning() << Q_FUNC_INFO << "Failed to deserialize floating window";
-            return false;
-        }
+    // Capturing is cheap and must happen here, as it touches widgets
+    std::unique_ptr<LayoutSaver::Layout> snapshot(new LayoutSaver::Layout());
+    if (!d->m_saver.d->collectLayout(*snapshot)) {
+        Q_EMIT saveFinished(false, false);
+        return;
     }
 
-    // 3. Restore closed dock widgets. They remain closed but acquire geometry and placeholder properties
-    for (const auto &dw : qAsConst(layout.closedDockWidgets)) {
-        if (d->matchesAffinity(dw->affinities)) {
-            DockWidgetBase::deserialize(dw);
-        }
+    // Compared before encoding anything. Windows whose layout didn't change share their
+    // serialized data with the last snapshot, so those compare in constant time.
+    if (d->m_lastWritten && d->m_lastWrittenFormat == d->m_saver.format() && *snapshot == *d->m_lastWritten) {
+        Q_EMIT saveFinished(true, false);
+        return;
     }
 
-    // 4. Restore the placeholder info, now that the Items have been created
-    for (const auto &dw : qAsConst(layout.allDockWidgets)) {
-        if (!d->matchesAffinity(dw->affinities))
-            continue;
+    detachDockWidgets(*snapshot);
+    d->m_snapshot = std::move(snapshot);
+    d->m_pool.start(new Private::WriteTask(d, *d->m_snapshot, ++d->m_generation));
+}
 
-        if (DockWidgetBase *dockWidget = d->m_dockRegistry->dockByName(dw->uniqueName)) {
-            dockWidget->lastPositions().deserialize(dw->lastPosition);
-        } else {
-            qWarning() << Q_FUNC_INFO << "Couldn't find dock widget" << dw->uniqueName;
-        }
+void LayoutAutoSaver::waitForFinished()
+{
+    while (d->m_snapshot) {
+        d->m_pool.waitForDone();
+        // Delivers the result, which might start another write if one was requested meanwhile
+        QCoreApplication::sendPostedEvents(&d->m_receiver, Private::WriteFinishedEvent::eventType());
     }
-
-    return true;
 }
 
 void LayoutSaver::setAffinityNames(const QStringList &affinityNames)
@@ -312,6 +1718,8 @@ void LayoutSaver::setAffinityNames(const QStringList &affinityNames)
         // Any window with empty affinity will also be subject to save/restore
         d->m_affinityNames << QString();
     }
+
+    d->m_affinitySet = AffinitySet(d->m_affinityNames);
 }
 
 DockWidgetBase::List LayoutSaver::restoredDockWidgets() const
@@ -336,13 +1744,94 @@ void LayoutSaver::Private::clearRestoredProperty()
 }
 
 template <typename T>
-void LayoutSaver::Private::deserializeWindowGeometry(const T &saved, QWidgetOrQuick *topLevel)
+void LayoutSaver::Private::deserializeWindowGeometry(const T &saved, QWidgetOrQuick *topLevel) const
 {
     topLevel->setGeometry(saved.geometry);
     topLevel->setVisible(saved.isVisible);
 }
 
-void LayoutSaver::Private::deleteEmptyFrames()
+namespace {
+///@brief What a frame shows. Frame ids differ between sessions, so frames are compared by content.
+struct FrameContents
+{
+    QStringList dockWidgetNames;
+    int currentTabIndex = -1;
+    unsigned int options = 0;
+
+    bool operator==(const FrameContents &other) const
+    {
+        return currentTabIndex == other.currentTabIndex && options == other.options
+                && dockWidgetNames == other.dockWidgetNames;
+    }
+};
+}
+
+///@brief Returns whether the Item trees @p saved and @p current have the same containers, orientations,
+///visibility and frame contents. Geometries aren't compared, those are restored in place.
+static bool itemTreesMatch(const QJsonObject &saved, const QJsonObject &current,
+                           const QHash<QString, FrameContents> &savedFrames,
+                           const QHash<QString, FrameContents> &currentFrames)
+{
+    const bool isContainer = saved.value(Keys::isContainer).toBool();
+    if (isContainer != current.value(Keys::isContainer).toBool()
+        || saved.value(Keys::isVisible).toBool() != current.value(Keys::isVisible).toBool())
+        return false;
+
+    if (!isContainer) {
+        const QString savedGuestId = saved.value(Keys::guestId).toString();
+        const QString currentGuestId = current.value(Keys::guestId).toString();
+        if (savedGuestId.isEmpty() || currentGuestId.isEmpty())
+            return savedGuestId.isEmpty() && currentGuestId.isEmpty();
+
+        auto savedIt = savedFrames.constFind(savedGuestId);
+        auto currentIt = currentFrames.constFind(currentGuestId);
+        return savedIt != savedFrames.constEnd() && currentIt != currentFrames.constEnd()
+                && *savedIt == *currentIt;
+    }
+
+    if (saved.value(Keys::orientation).toInt() != current.value(Keys::orientation).toInt())
+        return false;
+
+    const QJsonArray savedChildren = saved.value(Keys::children).toArray();
+    const QJsonArray currentChildren = current.value(Keys::children).toArray();
+    if (savedChildren.size() != currentChildren.size())
+        return false;
+
+    for (int i = 0; i < savedChildren.size(); ++i) {
+        if (!itemTreesMatch(savedChildren.at(i).toObject(), currentChildren.at(i).toObject(), savedFrames, currentFrames))
+            return false;
+    }
+
+    return true;
+}
+
+bool LayoutSaver::Private::mainWindowMatches(MainWindowBase *mainWindow, const LayoutSaver::MainWindow &saved) const
+{
+    QHash<QString, FrameContents> savedFrames;
+    for (auto it = saved.multiSplitterLayout.frames.cbegin(), end = saved.multiSplitterLayout.frames.cend(); it != end; ++it) {
+        FrameContents &contents = savedFrames[it.key()];
+        for (const auto &dw : qAsConst(it->dockWidgets))
+            contents.dockWidgetNames.push_back(dw->uniqueName);
+        contents.currentTabIndex = it->currentTabIndex;
+        contents.options = it->options;
+    }
+
+    auto multiSplitter = mainWindow->multiSplitter();
+    QHash<QString, FrameContents> currentFrames;
+    for (KDDockWidgets::Frame *frame : multiSplitter->frames()) {
+        FrameContents &contents = currentFrames[frame->id()];
+        for (DockWidgetBase *dw : frame->dockWidgets())
+            contents.dockWidgetNames.push_back(dw->uniqueName());
+        contents.currentTabIndex = frame->currentTabIndex();
+        contents.options = frame->options();
+    }
+
+    Layouting::ItemContainer *root = multiSplitter->rootItem();
+    return itemTreesMatch(saved.multiSplitterLayout.layout, root->toJsonObject(), savedFrames, currentFrames)
+            && root->canRestoreGeometries(saved.multiSplitterLayout.layout);
+}
+
+void LayoutSaver::Private::deleteEmptyFrames() const
 {
     // After a restore it can happen that some DockWidgets didn't exist, so weren't restored.
     // Delete their frame now.
@@ -393,10 +1882,43 @@ bool LayoutSaver::Layout::isValid() const
     return true;
 }
 
+QByteArray LayoutSaver::Layout::toBinary() const
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    QByteArray result;
+    CborWriter writer(&result);
+    write(writer);
+    return result;
+#else
+    qWarning() << Q_FUNC_INFO << "Binary layouts need Qt 5.12, saving as JSON instead";
+    return toJson();
+#endif
+}
+
+bool LayoutSaver::Layout::fromData(const QByteArray &data)
+{
+    QJsonObject object;
+    if (!jsonObjectFromData(data, object))
+        return false;
+
+    fromJsonObject(object);
+    return true;
+}
+
 QByteArray LayoutSaver::Layout::toJson() const
 {
-    QJsonDocument doc = QJsonDocument::fromVariant(toVariantMap());
-    return doc.toJson();
+    QByteArray result;
+    QBuffer buffer(&result);
+    buffer.open(QIODevice::WriteOnly);
+    writeJson(&buffer);
+    return result;
+}
+
+bool LayoutSaver::Layout::writeJson(QIODevice *device) const
+{
+    JsonWriter writer(device);
+    write(writer);
+    return !writer.hasError();
 }
 
 bool LayoutSaver::Layout::fromJson(const QByteArray &jsonData)
@@ -404,7 +1926,7 @@ bool LayoutSaver::Layout::fromJson(const QByteArray &jsonData)
     QJsonParseError error;
     QJsonDocument doc = QJsonDocument::fromJson(jsonData, &error);
     if (error.error == QJsonParseError::NoError)  {
-        fromVariantMap(doc.toVariant().toMap());
+        fromJsonObject(doc.object());
         return true;
     }
 
@@ -414,39 +1936,81 @@ bool LayoutSaver::Layout::fromJson(const QByteArray &jsonData)
 QVariantMap LayoutSaver::Layout::toVariantMap() const
 {
     QVariantMap map;
-    map.insert(QStringLiteral("serializationVersion"), serializationVersion);
-    map.insert(QStringLiteral("mainWindows"), toVariantList<LayoutSaver::MainWindow>(mainWindows));
-    map.insert(QStringLiteral("floatingWindows"), toVariantList<LayoutSaver::FloatingWindow>(floatingWindows));
-    map.insert(QStringLiteral("closedDockWidgets"), ::dockWidgetNames(closedDockWidgets));
-    map.insert(QStringLiteral("allDockWidgets"), toVariantList(allDockWidgets));
-    map.insert(QStringLiteral("screenInfo"), toVariantList<LayoutSaver::ScreenInfo>(screenInfo));
+    map.insert(Keys::serializationVersion, serializationVersion);
+    map.insert(Keys::mainWindows, toVariantList<LayoutSaver::MainWindow>(mainWindows));
+    map.insert(Keys::floatingWindows, toVariantList<LayoutSaver::FloatingWindow>(floatingWindows));
+    map.insert(Keys::closedDockWidgets, ::dockWidgetNames(closedDockWidgets));
+    map.insert(Keys::allDockWidgets, toVariantList(allDockWidgets));
+    map.insert(Keys::screenInfo, toVariantList<LayoutSaver::ScreenInfo>(screenInfo));
 
     return map;
 }
 
-void LayoutSaver::Layout::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::Layout::write(LayoutWriter &writer) const
+{
+    // Same keys as toVariantMap(), in the same order as QJsonDocument writes them
+    writer.beginObject();
+    writer.writeList(Keys::allDockWidgets, allDockWidgets);
+    writer.writeKey(Keys::closedDockWidgets);
+    writer.beginArray();
+    for (const auto &dw : closedDockWidgets)
+        writer.writeValue(dw->uniqueName);
+    writer.endArray();
+    writer.writeList(Keys::floatingWindows, floatingWindows);
+    writer.writeList(Keys::mainWindows, mainWindows);
+    writer.writeList(Keys::screenInfo, screenInfo);
+    writer.write(Keys::serializationVersion, serializationVersion);
+    writer.endObject();
+}
+
+void LayoutSaver::Layout::fromJsonObject(const QJsonObject &object)
 {
     allDockWidgets.clear();
-    const QVariantList dockWidgetsV = map.value(QStringLiteral("allDockWidgets")).toList();
-    for (const QVariant &v : dockWidgetsV) {
-        const QVariantMap dwV = v.toMap();
-        const QString name = dwV.value(QStringLiteral("uniqueName")).toString();
-        auto dw = LayoutSaver::DockWidget::dockWidgetForName(name);
-        dw->fromVariantMap(dwV);
+    const QJsonArray dockWidgetsJ = object.value(Keys::allDockWidgets).toArray();
+    allDockWidgets.reserve(dockWidgetsJ.size());
+    for (const QJsonValue &v : dockWidgetsJ) {
+        const QJsonObject dwJ = v.toObject();
+        auto dw = LayoutSaver::DockWidget::dockWidgetForName(dwJ.value(Keys::uniqueName).toString());
+        dw->fromJsonObject(dwJ);
         allDockWidgets.push_back(dw);
     }
 
     closedDockWidgets.clear();
-    const QVariantList closedDockWidgetsV = map.value(QStringLiteral("closedDockWidgets")).toList();
-    closedDockWidgets.reserve(closedDockWidgetsV.size());
-    for (const QVariant &v : closedDockWidgetsV) {
+    const QJsonArray closedDockWidgetsJ = object.value(Keys::closedDockWidgets).toArray();
+    closedDockWidgets.reserve(closedDockWidgetsJ.size());
+    for (const QJsonValue &v : closedDockWidgetsJ) {
         closedDockWidgets.push_back(LayoutSaver::DockWidget::dockWidgetForName(v.toString()));
     }
 
-    serializationVersion = map.value(QStringLiteral("serializationVersion")).toInt();
-    mainWindows = fromVariantList<LayoutSaver::MainWindow>(map.value(QStringLiteral("mainWindows")).toList());
-    floatingWindows = fromVariantList<LayoutSaver::FloatingWindow>(map.value(QStringLiteral("floatingWindows")).toList());
-    screenInfo = fromVariantList<LayoutSaver::ScreenInfo>(map.value(QStringLiteral("screenInfo")).toList());
+    serializationVersion = object.value(Keys::serializationVersion).toInt();
+    mainWindows = fromJsonArray<LayoutSaver::MainWindow>(object.value(Keys::mainWindows).toArray());
+    floatingWindows = fromJsonArray<LayoutSaver::FloatingWindow>(object.value(Keys::floatingWindows).toArray());
+    screenInfo = fromJsonArray<LayoutSaver::ScreenInfo>(object.value(Keys::screenInfo).toArray());
+}
+
+static bool sameDockWidgetNames(const LayoutSaver::DockWidget::List &a, const LayoutSaver::DockWidget::List &b)
+{
+    return a.size() == b.size()
+            && std::equal(a.cbegin(), a.cend(), b.cbegin(),
+                          [] (const LayoutSaver::DockWidget::Ptr &dw1, const LayoutSaver::DockWidget::Ptr &dw2) {
+        return dw1->uniqueName == dw2->uniqueName;
+    });
+}
+
+bool LayoutSaver::Layout::operator==(const Layout &other) const
+{
+    if (serializationVersion != other.serializationVersion || mainWindows != other.mainWindows
+        || floatingWindows != other.floatingWindows || screenInfo != other.screenInfo
+        || !sameDockWidgetNames(closedDockWidgets, other.closedDockWidgets)
+        || allDockWidgets.size() != other.allDockWidgets.size())
+        return false;
+
+    for (int i = 0; i < allDockWidgets.size(); ++i) {
+        if (!(*allDockWidgets.at(i) == *other.allDockWidgets.at(i)))
+            return false;
+    }
+
+    return true;
 }
 
 void LayoutSaver::Layout::scaleSizes()
@@ -546,41 +2110,64 @@ void LayoutSaver::Frame::scaleSizes(const ScalingInfo &scalingInfo)
 QVariantMap LayoutSaver::Frame::toVariantMap() const
 {
     QVariantMap map;
-    map.insert(QStringLiteral("id"), id);
-    map.insert(QStringLiteral("isNull"), isNull);
-    map.insert(QStringLiteral("objectName"), objectName);
-    map.insert(QStringLiteral("geometry"), Layouting::rectToMap(geometry));
-    map.insert(QStringLiteral("options"), options);
-    map.insert(QStringLiteral("currentTabIndex"), currentTabIndex);
+    map.insert(Keys::id, id);
+    map.insert(Keys::isNull, isNull);
+    map.insert(Keys::objectName, objectName);
+    map.insert(Keys::geometry, Layouting::rectToMap(geometry));
+    map.insert(Keys::options, options);
+    map.insert(Keys::currentTabIndex, currentTabIndex);
 
-    map.insert(QStringLiteral("dockWidgets"), dockWidgetNames(dockWidgets));
+    map.insert(Keys::dockWidgets, dockWidgetNames(dockWidgets));
 
     return map;
 }
 
-void LayoutSaver::Frame::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::Frame::write(LayoutWriter &writer) const
+{
+    writer.beginObject();
+    writer.write(Keys::currentTabIndex, currentTabIndex);
+    writer.writeKey(Keys::dockWidgets);
+    writer.beginArray();
+    for (const auto &dw : dockWidgets)
+        writer.writeValue(dw->uniqueName);
+    writer.endArray();
+    writer.write(Keys::geometry, geometry);
+    writer.write(Keys::id, id);
+    writer.write(Keys::isNull, isNull);
+    writer.write(Keys::objectName, objectName);
+    writer.write(Keys::options, int(options));
+    writer.endObject();
+}
+
+void LayoutSaver::Frame::fromJsonObject(const QJsonObject &object)
 {
-    if (map.isEmpty()) {
+    if (object.isEmpty()) {
         isNull = true;
         dockWidgets.clear();
         return;
     }
 
-    id = map.value(QStringLiteral("id")).toString();
-    isNull = map.value(QStringLiteral("isNull")).toBool();
-    objectName = map.value(QStringLiteral("objectName")).toString();
-    geometry = Layouting::mapToRect(map.value(QStringLiteral("geometry")).toMap());
-    options = map.value(QStringLiteral("options")).toUInt();
-    currentTabIndex = map.value(QStringLiteral("currentTabIndex")).toInt();
+    id = object.value(Keys::id).toString();
+    isNull = object.value(Keys::isNull).toBool();
+    objectName = object.value(Keys::objectName).toString();
+    geometry = jsonToRect(object.value(Keys::geometry));
+    options = static_cast<unsigned int>(object.value(Keys::options).toInt());
+    currentTabIndex = object.value(Keys::currentTabIndex).toInt();
 
-    const QVariantList dockWidgetsV = map.value(QStringLiteral("dockWidgets")).toList();
+    const QJsonArray dockWidgetsJ = object.value(Keys::dockWidgets).toArray();
 
     dockWidgets.clear();
-    dockWidgets.reserve(dockWidgetsV.size());
-    for (const auto &variant : dockWidgetsV) {
-        DockWidget::Ptr dw = DockWidget::dockWidgetForName(variant.toString());
-        dockWidgets.push_back(dw);
-    }
+    dockWidgets.reserve(dockWidgetsJ.size());
+    for (const QJsonValue &v : dockWidgetsJ)
+        dockWidgets.push_back(DockWidget::dockWidgetForName(v.toString()));
+}
+
+bool LayoutSaver::Frame::operator==(const Frame &other) const
+{
+    // Only the names of the dock widgets are saved with the frame
+    return isNull == other.isNull && objectName == other.objectName && geometry == other.geometry
+            && options == other.options && currentTabIndex == other.currentTabIndex && id == other.id
+            && sameDockWidgetNames(dockWidgets, other.dockWidgets);
 }
 
 bool LayoutSaver::DockWidget::isValid() const
@@ -597,25 +2184,42 @@ QVariantMap LayoutSaver::DockWidget::toVariantMap() const
 {
     QVariantMap map;
     if (!affinities.isEmpty())
-        map.insert(QStringLiteral("affinities"), stringListToVariant(affinities));
-    map.insert(QStringLiteral("uniqueName"), uniqueName);
-    map.insert(QStringLiteral("lastPosition"), lastPosition.toVariantMap());
+        map.insert(Keys::affinities, stringListToVariant(affinities));
+    map.insert(Keys::uniqueName, uniqueName);
+    map.insert(Keys::lastPosition, lastPosition.toVariantMap());
 
     return map;
 }
 
-void LayoutSaver::DockWidget::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::DockWidget::write(LayoutWriter &writer) const
 {
-    affinities = variantToStringList(map.value(QStringLiteral("affinities")).toList());
+    writer.beginObject();
+    if (!affinities.isEmpty())
+        writer.write(Keys::affinities, affinities);
+    writer.writeKey(Keys::lastPosition);
+    lastPosition.write(writer);
+    writer.write(Keys::uniqueName, uniqueName);
+    writer.endObject();
+}
+
+void LayoutSaver::DockWidget::fromJsonObject(const QJsonObject &object)
+{
+    affinities = jsonToStringList(object.value(Keys::affinities));
 
     // Compatibility hack. Old json format had a single "affinityName" instead of an "affinities" list:
-    const QString affinityName = map.value(QStringLiteral("affinityName")).toString();
+    const QString affinityName = object.value(Keys::affinityName).toString();
     if (!affinityName.isEmpty() && !affinities.contains(affinityName)) {
         affinities.push_back(affinityName);
     }
 
-    uniqueName = map.value(QStringLiteral("uniqueName")).toString();
-    lastPosition.fromVariantMap(map.value(QStringLiteral("lastPosition")).toMap());
+    uniqueName = object.value(Keys::uniqueName).toString();
+    lastPosition.fromJsonObject(object.value(Keys::lastPosition).toObject());
+}
+
+bool LayoutSaver::DockWidget::operator==(const DockWidget &other) const
+{
+    return uniqueName == other.uniqueName && affinities == other.affinities
+            && lastPosition == other.lastPosition;
 }
 
 bool LayoutSaver::FloatingWindow::isValid() const
@@ -640,36 +2244,59 @@ void LayoutSaver::FloatingWindow::scaleSizes(const ScalingInfo &scalingInfo)
 QVariantMap LayoutSaver::FloatingWindow::toVariantMap() const
 {
     QVariantMap map;
-    map.insert(QStringLiteral("multiSplitterLayout"), multiSplitterLayout.toVariantMap());
-    map.insert(QStringLiteral("parentIndex"), parentIndex);
-    map.insert(QStringLiteral("geometry"), Layouting::rectToMap(geometry));
-    map.insert(QStringLiteral("screenIndex"), screenIndex);
-    map.insert(QStringLiteral("screenSize"), Layouting::sizeToMap(screenSize));
-    map.insert(QStringLiteral("isVisible"), isVisible);
+    map.insert(Keys::multiSplitterLayout, multiSplitterLayout.toVariantMap());
+    map.insert(Keys::parentIndex, parentIndex);
+    map.insert(Keys::geometry, Layouting::rectToMap(geometry));
+    map.insert(Keys::screenIndex, screenIndex);
+    map.insert(Keys::screenSize, Layouting::sizeToMap(screenSize));
+    map.insert(Keys::isVisible, isVisible);
 
     if (!affinities.isEmpty())
-        map.insert(QStringLiteral("affinityName"), stringListToVariant(affinities));
+        map.insert(Keys::affinityName, stringListToVariant(affinities));
 
     return map;
 }
 
-void LayoutSaver::FloatingWindow::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::FloatingWindow::write(LayoutWriter &writer) const
+{
+    writer.beginObject();
+    if (!affinities.isEmpty())
+        writer.write(Keys::affinityName, affinities);
+    writer.write(Keys::geometry, geometry);
+    writer.write(Keys::isVisible, isVisible);
+    writer.writeKey(Keys::multiSplitterLayout);
+    multiSplitterLayout.write(writer);
+    writer.write(Keys::parentIndex, parentIndex);
+    writer.write(Keys::screenIndex, screenIndex);
+    writer.write(Keys::screenSize, screenSize);
+    writer.endObject();
+}
+
+void LayoutSaver::FloatingWindow::fromJsonObject(const QJsonObject &object)
 {
-    multiSplitterLayout.fromVariantMap(map.value(QStringLiteral("multiSplitterLayout")).toMap());
-    parentIndex = map.value(QStringLiteral("parentIndex")).toInt();
-    geometry = Layouting::mapToRect(map.value(QStringLiteral("geometry")).toMap());
-    screenIndex = map.value(QStringLiteral("screenIndex")).toInt();
-    screenSize = Layouting::mapToSize(map.value(QStringLiteral("screenSize")).toMap());
-    isVisible = map.value(QStringLiteral("isVisible")).toBool();
-    affinities = variantToStringList(map.value(QStringLiteral("affinities")).toList());
+    multiSplitterLayout.fromJsonObject(object.value(Keys::multiSplitterLayout).toObject());
+    parentIndex = object.value(Keys::parentIndex).toInt();
+    geometry = jsonToRect(object.value(Keys::geometry));
+    screenIndex = object.value(Keys::screenIndex).toInt();
+    screenSize = jsonToSize(object.value(Keys::screenSize));
+    isVisible = object.value(Keys::isVisible).toBool();
+    affinities = jsonToStringList(object.value(Keys::affinities));
 
     // Compatibility hack. Old json format had a single "affinityName" instead of an "affinities" list:
-    const QString affinityName = map.value(QStringLiteral("affinityName")).toString();
+    const QString affinityName = object.value(Keys::affinityName).toString();
     if (!affinityName.isEmpty() && !affinities.contains(affinityName)) {
         affinities.push_back(affinityName);
     }
 }
 
+bool LayoutSaver::FloatingWindow::operator==(const FloatingWindow &other) const
+{
+    return multiSplitterLayout == other.multiSplitterLayout && affinities == other.affinities
+            && parentIndex == other.parentIndex && geometry == other.geometry
+            && screenIndex == other.screenIndex && screenSize == other.screenSize
+            && isVisible == other.isVisible;
+}
+
 bool LayoutSaver::MainWindow::isValid() const
 {
     if (!multiSplitterLayout.isValid())
@@ -700,35 +2327,57 @@ void LayoutSaver::MainWindow::scaleSizes()
 QVariantMap LayoutSaver::MainWindow::toVariantMap() const
 {
     QVariantMap map;
-    map.insert(QStringLiteral("options"), int(options));
-    map.insert(QStringLiteral("multiSplitterLayout"), multiSplitterLayout.toVariantMap());
-    map.insert(QStringLiteral("uniqueName"), uniqueName);
-    map.insert(QStringLiteral("geometry"), Layouting::rectToMap(geometry));
-    map.insert(QStringLiteral("screenIndex"), screenIndex);
-    map.insert(QStringLiteral("screenSize"), Layouting::sizeToMap(screenSize));
-    map.insert(QStringLiteral("isVisible"), isVisible);
-    map.insert(QStringLiteral("affinities"), stringListToVariant(affinities));
+    map.insert(Keys::options, int(options));
+    map.insert(Keys::multiSplitterLayout, multiSplitterLayout.toVariantMap());
+    map.insert(Keys::uniqueName, uniqueName);
+    map.insert(Keys::geometry, Layouting::rectToMap(geometry));
+    map.insert(Keys::screenIndex, screenIndex);
+    map.insert(Keys::screenSize, Layouting::sizeToMap(screenSize));
+    map.insert(Keys::isVisible, isVisible);
+    map.insert(Keys::affinities, stringListToVariant(affinities));
 
     return map;
 }
 
-void LayoutSaver::MainWindow::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::MainWindow::write(LayoutWriter &writer) const
+{
+    writer.beginObject();
+    writer.write(Keys::affinities, affinities);
+    writer.write(Keys::geometry, geometry);
+    writer.write(Keys::isVisible, isVisible);
+    writer.writeKey(Keys::multiSplitterLayout);
+    multiSplitterLayout.write(writer);
+    writer.write(Keys::options, int(options));
+    writer.write(Keys::screenIndex, screenIndex);
+    writer.write(Keys::screenSize, screenSize);
+    writer.write(Keys::uniqueName, uniqueName);
+    writer.endObject();
+}
+
+void LayoutSaver::MainWindow::fromJsonObject(const QJsonObject &object)
 {
-    options = KDDockWidgets::MainWindowOptions(map.value(QStringLiteral("options")).toInt());
-    multiSplitterLayout.fromVariantMap(map.value(QStringLiteral("multiSplitterLayout")).toMap());
-    uniqueName = map.value(QStringLiteral("uniqueName")).toString();
-    geometry = Layouting::mapToRect(map.value(QStringLiteral("geometry")).toMap());
-    screenIndex = map.value(QStringLiteral("screenIndex")).toInt();
-    screenSize = Layouting::mapToSize(map.value(QStringLiteral("screenSize")).toMap());
-    isVisible = map.value(QStringLiteral("isVisible")).toBool();
-    affinities = variantToStringList(map.value(QStringLiteral("affinities")).toList());
+    options = KDDockWidgets::MainWindowOptions(object.value(Keys::options).toInt());
+    multiSplitterLayout.fromJsonObject(object.value(Keys::multiSplitterLayout).toObject());
+    uniqueName = object.value(Keys::uniqueName).toString();
+    geometry = jsonToRect(object.value(Keys::geometry));
+    screenIndex = object.value(Keys::screenIndex).toInt();
+    screenSize = jsonToSize(object.value(Keys::screenSize));
+    isVisible = object.value(Keys::isVisible).toBool();
+    affinities = jsonToStringList(object.value(Keys::affinities));
 
     // Compatibility hack. Old json format had a single "affinityName" instead of an "affinities" list:
-    const QString affinityName = map.value(QStringLiteral("affinityName")).toString();
+    const QString affinityName = object.value(Keys::affinityName).toString();
     if (!affinityName.isEmpty() && !affinities.contains(affinityName)) {
         affinities.push_back(affinityName);
     }
+}
 
+bool LayoutSaver::MainWindow::operator==(const MainWindow &other) const
+{
+    return options == other.options && multiSplitterLayout == other.multiSplitterLayout
+            && uniqueName == other.uniqueName && affinities == other.affinities
+            && geometry == other.geometry && screenIndex == other.screenIndex
+            && screenSize == other.screenSize && isVisible == other.isVisible;
 }
 
 bool LayoutSaver::MultiSplitter::isValid() const
@@ -754,28 +2403,52 @@ void LayoutSaver::MultiSplitter::scaleSizes(const ScalingInfo &)
 QVariantMap LayoutSaver::MultiSplitter::toVariantMap() const
 {
     QVariantMap result;
-    result.insert(QStringLiteral("layout"), layout);
+    result.insert(Keys::layout, layout.toVariantMap());
 
     QVariantMap framesV;
     for (auto &frame : frames)
         framesV.insert(frame.id, frame.toVariantMap());
 
-    result.insert(QStringLiteral("frames"), framesV);
+    result.insert(Keys::frames, framesV);
     return result;
 }
 
-void LayoutSaver::MultiSplitter::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::MultiSplitter::write(LayoutWriter &writer) const
+{
+    writer.beginObject();
+    writer.writeKey(Keys::frames);
+    writer.beginObject();
+    QStringList ids = frames.keys();
+    std::sort(ids.begin(), ids.end());
+    for (const QString &id : qAsConst(ids)) {
+        writer.writeKey(id);
+        frames.value(id).write(writer);
+    }
+    writer.endObject();
+    writer.write(Keys::layout, QJsonValue(layout));
+    writer.endObject();
+}
+
+void LayoutSaver::MultiSplitter::fromJsonObject(const QJsonObject &object)
 {
-    layout = map.value(QStringLiteral("layout")).toMap();
-    const QVariantMap framesV = map.value(QStringLiteral("frames")).toMap();
+    layout = object.value(Keys::layout).toObject();
+
+    const QJsonObject framesJ = object.value(Keys::frames).toObject();
     frames.clear();
-    for (const QVariant &frameV : framesV) {
+    frames.reserve(framesJ.size());
+    for (auto it = framesJ.constBegin(), end = framesJ.constEnd(); it != end; ++it) {
         LayoutSaver::Frame frame;
-        frame.fromVariantMap(frameV.toMap());
+        frame.fromJsonObject(it.value().toObject());
         frames.insert(frame.id, frame);
     }
 }
 
+bool LayoutSaver::MultiSplitter::operator==(const MultiSplitter &other) const
+{
+    // Cheap when both come from the same MultiSplitter::serialize() cache, as the data is shared
+    return layout == other.layout && frames == other.frames;
+}
+
 void LayoutSaver::Position::scaleSizes(const ScalingInfo &scalingInfo)
 {
     scalingInfo.applyFactorsTo(/*by-ref*/lastFloatingGeometry);
@@ -784,61 +2457,115 @@ void LayoutSaver::Position::scaleSizes(const ScalingInfo &scalingInfo)
 QVariantMap LayoutSaver::Position::toVariantMap() const
 {
     QVariantMap map;
-    map.insert(QStringLiteral("lastFloatingGeometry"), Layouting::rectToMap(lastFloatingGeometry));
-    map.insert(QStringLiteral("tabIndex"), tabIndex);
-    map.insert(QStringLiteral("wasFloating"), wasFloating);
-    map.insert(QStringLiteral("placeholders"), toVariantList<LayoutSaver::Placeholder>(placeholders));
+    map.insert(Keys::lastFloatingGeometry, Layouting::rectToMap(lastFloatingGeometry));
+    map.insert(Keys::tabIndex, tabIndex);
+    map.insert(Keys::wasFloating, wasFloating);
+    map.insert(Keys::placeholders, toVariantList<LayoutSaver::Placeholder>(placeholders));
 
     return map;
 }
 
-void LayoutSaver::Position::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::Position::write(LayoutWriter &writer) const
+{
+    writer.beginObject();
+    writer.write(Keys::lastFloatingGeometry, lastFloatingGeometry);
+    writer.writeList(Keys::placeholders, placeholders);
+    writer.write(Keys::tabIndex, tabIndex);
+    writer.write(Keys::wasFloating, wasFloating);
+    writer.endObject();
+}
+
+void LayoutSaver::Position::fromJsonObject(const QJsonObject &object)
+{
+    lastFloatingGeometry = jsonToRect(object.value(Keys::lastFloatingGeometry));
+    tabIndex = object.value(Keys::tabIndex).toInt();
+    wasFloating = object.value(Keys::wasFloating).toBool();
+    placeholders = fromJsonArray<LayoutSaver::Placeholder>(object.value(Keys::placeholders).toArray());
+}
+
+bool LayoutSaver::Position::operator==(const Position &other) const
 {
-    lastFloatingGeometry = Layouting::mapToRect(map.value(QStringLiteral("lastFloatingGeometry")).toMap());
-    tabIndex = map.value(QStringLiteral("tabIndex")).toInt();
-    wasFloating = map.value(QStringLiteral("wasFloating")).toBool();
-    placeholders = fromVariantList<LayoutSaver::Placeholder>(map.value(QStringLiteral("placeholders")).toList());
+    return lastFloatingGeometry == other.lastFloatingGeometry && tabIndex == other.tabIndex
+            && wasFloating == other.wasFloating && placeholders == other.placeholders;
 }
 
 QVariantMap LayoutSaver::ScreenInfo::toVariantMap() const
 {
     QVariantMap map;
-    map.insert(QStringLiteral("index"), index);
-    map.insert(QStringLiteral("geometry"), Layouting::rectToMap(geometry));
-    map.insert(QStringLiteral("name"), name);
-    map.insert(QStringLiteral("devicePixelRatio"), devicePixelRatio);
+    map.insert(Keys::index, index);
+    map.insert(Keys::geometry, Layouting::rectToMap(geometry));
+    map.insert(Keys::name, name);
+    map.insert(Keys::devicePixelRatio, devicePixelRatio);
 
     return map;
 }
 
-void LayoutSaver::ScreenInfo::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::ScreenInfo::write(LayoutWriter &writer) const
+{
+    writer.beginObject();
+    writer.write(Keys::devicePixelRatio, devicePixelRatio);
+    writer.write(Keys::geometry, geometry);
+    writer.write(Keys::index, index);
+    writer.write(Keys::name, name);
+    writer.endObject();
+}
+
+void LayoutSaver::ScreenInfo::fromJsonObject(const QJsonObject &object)
 {
-    index = map.value(QStringLiteral("index")).toInt();
-    geometry = Layouting::mapToRect(map.value(QStringLiteral("geometry")).toMap());
-    name = map.value(QStringLiteral("name")).toString();
-    devicePixelRatio = map.value(QStringLiteral("devicePixelRatio")).toDouble();
+    index = object.value(Keys::index).toInt();
+    geometry = jsonToRect(object.value(Keys::geometry));
+    name = object.value(Keys::name).toString();
+    devicePixelRatio = object.value(Keys::devicePixelRatio).toDouble();
+}
+
+bool LayoutSaver::ScreenInfo::operator==(const ScreenInfo &other) const
+{
+    return index == other.index && geometry == other.geometry && name == other.name
+            && qFuzzyCompare(devicePixelRatio, other.devicePixelRatio);
 }
 
 QVariantMap LayoutSaver::Placeholder::toVariantMap() const
 {
     QVariantMap map;
-    map.insert(QStringLiteral("isFloatingWindow"), isFloatingWindow);
-    map.insert(QStringLiteral("itemIndex"), itemIndex);
+    map.insert(Keys::isFloatingWindow, isFloatingWindow);
+    map.insert(Keys::itemIndex, itemIndex);
 
     if (isFloatingWindow)
-        map.insert(QStringLiteral("indexOfFloatingWindow"), indexOfFloatingWindow);
+        map.insert(Keys::indexOfFloatingWindow, indexOfFloatingWindow);
     else
-        map.insert(QStringLiteral("mainWindowUniqueName"), mainWindowUniqueName);
+        map.insert(Keys::mainWindowUniqueName, mainWindowUniqueName);
 
     return map;
 }
 
-void LayoutSaver::Placeholder::fromVariantMap(const QVariantMap &map)
+void LayoutSaver::Placeholder::write(LayoutWriter &writer) const
+{
+    writer.beginObject();
+    if (isFloatingWindow)
+        writer.write(Keys::indexOfFloatingWindow, indexOfFloatingWindow);
+    writer.write(Keys::isFloatingWindow, isFloatingWindow);
+    writer.write(Keys::itemIndex, itemIndex);
+    if (!isFloatingWindow)
+        writer.write(Keys::mainWindowUniqueName, mainWindowUniqueName);
+    writer.endObject();
+}
+
+void LayoutSaver::Placeholder::fromJsonObject(const QJsonObject &object)
+{
+    isFloatingWindow = object.value(Keys::isFloatingWindow).toBool();
+    indexOfFloatingWindow = object.value(Keys::indexOfFloatingWindow).toInt(-1);
+    itemIndex = object.value(Keys::itemIndex).toInt();
+    mainWindowUniqueName = object.value(Keys::mainWindowUniqueName).toString();
+}
+
+bool LayoutSaver::Placeholder::operator==(const Placeholder &other) const
 {
-    isFloatingWindow = map.value(QStringLiteral("isFloatingWindow")).toBool();
-    indexOfFloatingWindow = map.value(QStringLiteral("indexOfFloatingWindow"), -1).toInt();
-    itemIndex = map.value(QStringLiteral("itemIndex")).toInt();
-    mainWindowUniqueName = map.value(QStringLiteral("mainWindowUniqueName")).toString();
+    // Same fields as write(), the others aren't initialized
+    if (isFloatingWindow != other.isFloatingWindow || itemIndex != other.itemIndex)
+        return false;
+
+    return isFloatingWindow ? indexOfFloatingWindow == other.indexOfFloatingWindow
+                            : mainWindowUniqueName == other.mainWindowUniqueName;
 }
 
 LayoutSaver::ScalingInfo::ScalingInfo(const QString &mainWindowId, QRect savedMainWindowGeo)
@@ -32,6 +32,8 @@
 
 #include "KDDockWidgets.h"
 
+#include <QObject>
+
 QT_BEGIN_NAMESPACE
 class QByteArray;
 QT_END_NAMESPACE
@@ -39,10 +41,18 @@ QT_END_NAMESPACE
 namespace KDDockWidgets {
 
 class DockWidgetBase;
+class AsyncLayoutRestore;
+class LayoutAutoSaver;
 
 class DOCKS_EXPORT LayoutSaver
 {
 public:
+    ///@brief The formats serializeLayout() can produce. restoreLayout() detects the format by itself.
+    enum class Format {
+        Json, ///< Human readable JSON. The default.
+        Binary ///< CBOR. Smaller and faster to parse. Requires Qt 5.12, JSON is used otherwise.
+    };
+
     ///@brief Constructor. Construction on the stack is suggested.
     explicit LayoutSaver(RestoreOptions options = RestoreOption_None);
 
@@ -71,6 +81,17 @@ public:
      */
     QByteArray serializeLayout() const;
 
+    ///@brief Sets the format used by serializeLayout() and saveToFile(). Default is Format::Json.
+    void setFormat(Format);
+    Format format() const;
+
+    /**
+     * @brief Converts a serialized layout to the format @p format
+     * No information is lost, so layouts can go back and forth between JSON and binary.
+     * Returns an empty byte array if @p data can't be parsed.
+     */
+    static QByteArray convertLayout(const QByteArray &data, Format format);
+
     /**
      * @brief restores the layout from a byte array
      * All MainWindows and DockWidgets should have been created before calling
@@ -79,12 +100,30 @@ public:
      * If not all DockWidgets can be created beforehand then make sure to set
      * a DockWidget factory via Config::setDockWidgetFactoryFunc()
      *
-     * @sa Config::setDockWidgetFactoryFunc()
+     * Only one restore can run at a time. While one is in progress, for example a
+     * @ref restoreLayoutAsync() that didn't finish yet, this prints a warning and returns false.
+     *
+     * @sa Config::setDockWidgetFactoryFunc(), restoreInProgress()
      *
      * @return true on success
      */
     bool restoreLayout(const QByteArray &);
 
+    /**
+     * @brief restores the layout from a byte array, without blocking the event loop
+     *
+     * The restore is done in small steps, each time the event loop runs. Use the returned object to
+     * follow its progress, or to cancel it. It deletes itself when finished.
+     * @ref restoreInProgress() returns true until then.
+     *
+     * The current layout is saved first, also in small steps, so @ref AsyncLayoutRestore::cancel()
+     * can go back to it.
+     *
+     * Returns nullptr if there's already a restore in progress.
+     * @sa restoreLayout()
+     */
+    AsyncLayoutRestore *restoreLayoutAsync(const QByteArray &);
+
     /**
      * @brief returns a list of dock widgets which were restored since the last
      * @ref restoreLayout() or @ref restoreFromDisk()
@@ -115,10 +154,118 @@ public:
 private:
     Q_DISABLE_COPY(LayoutSaver)
     friend class TestDocks;
+    friend class AsyncLayoutRestore;
+    friend class LayoutAutoSaver;
+
+    class Private;
+    Private *const d;
+};
+
+/**
+ * @brief A layout restore that runs in time slices from the event loop
+ *
+ * Created by @ref LayoutSaver::restoreLayoutAsync(). Each time the event loop runs, the restore
+ * advances for at most @ref timeBudget() milliseconds, then gives control back so the application
+ * stays responsive.
+ */
+class DOCKS_EXPORT AsyncLayoutRestore : public QObject
+{
+    Q_OBJECT
+public:
+    ~AsyncLayoutRestore() override;
+
+    ///@brief Sets how many milliseconds each slice of the restore can take. Default is 10.
+    void setTimeBudget(int milliseconds);
+    int timeBudget() const;
+
+    ///@brief Returns how much of the restore is done, between 0 and 1
+    double progress() const;
+
+    ///@brief Returns whether the restore finished, successfully or not
+    bool isFinished() const;
+
+    ///@brief Stops the restore and goes back to the layout we had before it started.
+    ///finished() is emitted with false.
+    void cancel();
+
+Q_SIGNALS:
+    void progressChanged(double progress);
+
+    ///@brief Emitted when the restore is over. @p success is false if it failed or was cancelled.
+    void finished(bool success);
+
+private:
+    friend class LayoutSaver;
+    explicit AsyncLayoutRestore(const LayoutSaver &, const QByteArray &data);
+    bool step();
+    void processSteps();
+    void finish(bool success);
+    Q_DISABLE_COPY(AsyncLayoutRestore)
 
     class Private;
     Private *const d;
 };
+
+
+/**
+ * @brief Saves the layout to a file in the background
+ *
+ * Call @ref scheduleSave() whenever the layout might have changed, or use @ref setInterval().
+ * Bursts of requests result in a single save. The layout is captured on the GUI thread, then
+ * encoded and written by a worker thread, so slow disks don't stall the GUI. The file is replaced
+ * atomically, and isn't touched at all if the layout didn't change since the last save.
+ */
+class DOCKS_EXPORT LayoutAutoSaver : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LayoutAutoSaver(const QString &filename, QObject *parent = nullptr);
+
+    ///@brief Destructor. Waits for the write in progress, if any.
+    ~LayoutAutoSaver() override;
+
+    QString fileName() const;
+
+    ///@brief Sets the format of the saved file. Default is LayoutSaver::Format::Json.
+    void setFormat(LayoutSaver::Format);
+    LayoutSaver::Format format() const;
+
+    ///@brief See LayoutSaver::setAffinityNames()
+    void setAffinityNames(const QStringList &affinityNames);
+
+    ///@brief Sets how long @ref scheduleSave() waits for more requests before saving. Default is 500ms.
+    void setDebounceInterval(int milliseconds);
+    int debounceInterval() const;
+
+    ///@brief Saves every @p milliseconds, if anything changed. 0 disables it, which is the default.
+    void setInterval(int milliseconds);
+    int interval() const;
+
+    ///@brief Requests a save, which happens after @ref debounceInterval() ms without further requests
+    void scheduleSave();
+
+    ///@brief Captures the layout right away, without waiting for the debounce interval.
+    ///If a write is still running, a new one starts as soon as it's finished.
+    void saveNow();
+
+    ///@brief Blocks until all requested writes are done
+    void waitForFinished();
+
+Q_SIGNALS:
+    /**
+     * @brief Emitted after each save
+     * @p success is false if the layout couldn't be captured or written.
+     * @p fileWritten is false if the file was left untouched, for example because nothing changed.
+     */
+    void saveFinished(bool success, bool fileWritten);
+
+private:
+    Q_DISABLE_COPY(LayoutAutoSaver)
+
+    class Private;
+    Private *const d;
+};
+
 }
 
 #endif
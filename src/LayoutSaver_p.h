@@ -28,7 +28,14 @@
 #include <QDebug>
 #include <QScreen>
 #include <QApplication>
+#include <QJsonArray>
 #include <QJsonDocument>
+#include <QJsonObject>
+#include <QVariant>
+#include <QVector>
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+# include <QCborStreamWriter>
+#endif
 
 #include <memory>
 
@@ -43,17 +50,139 @@
 #define KDDOCKWIDGETS_SERIALIZATION_VERSION 3
 
 
+QT_BEGIN_NAMESPACE
+class QIODevice;
+QT_END_NAMESPACE
+
 namespace KDDockWidgets {
 
+///@brief Writes a layout in one of the LayoutSaver::Format formats, see LayoutSaver::Layout::write()
+///The structs only say what to write, the subclasses know the encoding.
+class LayoutWriter
+{
+public:
+    virtual ~LayoutWriter();
+
+    virtual void beginObject() = 0;
+    virtual void endObject() = 0;
+    virtual void beginArray() = 0;
+    virtual void endArray() = 0;
+    virtual void writeKey(const QString &key) = 0;
+    virtual void writeKey(QLatin1String key);
+
+    virtual void writeNull() = 0;
+    virtual void writeValue(int) = 0;
+    virtual void writeValue(bool) = 0;
+    virtual void writeValue(double) = 0;
+    virtual void writeValue(const QString &) = 0;
+    void writeValue(QRect);
+    void writeValue(QSize);
+    void writeValue(const QStringList &);
+    void writeValue(const QJsonValue &);
+
+    template <typename T>
+    void write(QLatin1String key, const T &value)
+    {
+        writeKey(key);
+        writeValue(value);
+    }
+
+    ///@brief Writes an array with the result of calling write() on each element of @p list
+    template <typename List>
+    void writeList(QLatin1String key, const List &list)
+    {
+        writeKey(key);
+        beginArray();
+        for (const auto &element : list)
+            writeElement(element);
+        endArray();
+    }
+
+    bool hasError() const { return m_hasError; }
+
+protected:
+    bool m_hasError = false;
+
+private:
+    template <typename T>
+    void writeElement(const T &element) { element.write(*this); }
+    template <typename T>
+    void writeElement(const std::shared_ptr<T> &element) { element->write(*this); }
+};
+
+///@brief Writes JSON directly to a QIODevice
+class JsonWriter : public LayoutWriter
+{
+public:
+    explicit JsonWriter(QIODevice *device);
+
+    using LayoutWriter::writeKey;
+    using LayoutWriter::writeValue;
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void writeKey(const QString &key) override;
+
+    void writeNull() override;
+    void writeValue(int) override;
+    void writeValue(bool) override;
+    void writeValue(double) override;
+    void writeValue(const QString &) override;
+
+private:
+    void beginValue();
+    void writeRaw(const QByteArray &);
+    void writeString(const QString &);
+    void writeIndent();
+
+    struct Scope {
+        bool isArray;
+        int count;
+    };
+
+    QIODevice *const m_device;
+    QVector<Scope> m_scopes;
+    bool m_afterKey = false;
+};
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+///@brief Writes the binary format, CBOR whose keys are mostly integer tags, directly to a QByteArray
+class CborWriter : public LayoutWriter
+{
+public:
+    explicit CborWriter(QByteArray *data);
+
+    using LayoutWriter::writeValue;
+
+    void beginObject() override;
+    void endObject() override;
+    void beginArray() override;
+    void endArray() override;
+    void writeKey(const QString &key) override;
+    void writeKey(QLatin1String key) override;
+
+    void writeNull() override;
+    void writeValue(int) override;
+    void writeValue(bool) override;
+    void writeValue(double) override;
+    void writeValue(const QString &) override;
+
+private:
+    QCborStreamWriter m_writer;
+};
+#endif
+
 template <typename T>
-typename T::List fromVariantList(const QVariantList &listV)
+typename T::List fromJsonArray(const QJsonArray &array)
 {
     typename T::List result;
 
-    result.reserve(listV.size());
-    for (const QVariant &v : listV) {
+    result.reserve(array.size());
+    for (const QJsonValue &v : array) {
         T t;
-        t.fromVariantMap(v.toMap());
+        t.fromJsonObject(v.toObject());
         result.push_back(t);
     }
 
@@ -76,7 +205,9 @@ struct LayoutSaver::Placeholder
     typedef QVector<LayoutSaver::Placeholder> List;
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const Placeholder &other) const;
 
     bool isFloatingWindow;
     int indexOfFloatingWindow;
@@ -118,7 +249,9 @@ struct LayoutSaver::Position
     void scaleSizes(const ScalingInfo &scalingInfo);
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const Position &other) const;
 };
 
 struct DOCKS_EXPORT LayoutSaver::DockWidget
@@ -147,7 +280,9 @@ struct DOCKS_EXPORT LayoutSaver::DockWidget
     }
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const DockWidget &other) const;
 
     QString uniqueName;
     QStringList affinities;
@@ -186,7 +321,9 @@ struct LayoutSaver::Frame
     void scaleSizes(const ScalingInfo &scalingInfo);
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const Frame &other) const;
 
     bool isNull = true;
     QString objectName;
@@ -205,9 +342,11 @@ struct LayoutSaver::MultiSplitter
     void scaleSizes(const ScalingInfo &scalingInfo);
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const MultiSplitter &other) const;
 
-    QVariantMap layout;
+    QJsonObject layout;
     QHash<QString, LayoutSaver::Frame> frames;
 };
 
@@ -221,7 +360,9 @@ struct LayoutSaver::FloatingWindow
     void scaleSizes(const ScalingInfo &);
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const FloatingWindow &other) const;
 
     LayoutSaver::MultiSplitter multiSplitterLayout;
     QStringList affinities;
@@ -243,7 +384,9 @@ public:
     void scaleSizes();
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const MainWindow &other) const;
 
     KDDockWidgets::MainWindowOptions options;
     LayoutSaver::MultiSplitter multiSplitterLayout;
@@ -264,7 +407,9 @@ struct LayoutSaver::ScreenInfo
     typedef QVector<LayoutSaver::ScreenInfo> List;
 
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const ScreenInfo &other) const;
 
     int index;
     QRect geometry;
@@ -272,7 +417,7 @@ struct LayoutSaver::ScreenInfo
     double devicePixelRatio;
 };
 
-struct LayoutSaver::Layout
+struct DOCKS_EXPORT_FOR_UNIT_TESTS LayoutSaver::Layout
 {
 public:
 
@@ -291,15 +436,23 @@ public:
     }
 
     ~Layout() {
-        s_currentLayoutBeingRestored = nullptr;
+        if (s_currentLayoutBeingRestored == this)
+            s_currentLayoutBeingRestored = nullptr;
     }
 
     bool isValid() const;
 
     QByteArray toJson() const;
+    bool writeJson(QIODevice *device) const;
     bool fromJson(const QByteArray &jsonData);
+    QByteArray toBinary() const;
+
+    ///@brief Loads a layout saved in any of the LayoutSaver::Format formats
+    bool fromData(const QByteArray &data);
     QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &map);
+    void write(LayoutWriter &) const;
+    void fromJsonObject(const QJsonObject &object);
+    bool operator==(const Layout &other) const;
 
     /// Iterates through the layout and patches all absolute sizes. See RestoreOption_RelativeToMainWindow.
     void scaleSizes();
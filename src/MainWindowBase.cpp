@@ -28,12 +28,16 @@
 
 #include "MainWindowBase.h"
 #include "DockRegistry_p.h"
+#include "AffinitySet_p.h"
 #include "DropArea_p.h"
 #include "Frame_p.h"
 #include "Utils_p.h"
 #include "Logging_p.h"
 #include "DropAreaWithCentralFrame_p.h"
 #include "widgets/MultiSplitter_p.h"
+#include "multisplitter/Item_p.h"
+
+#include <QSet>
 
 using namespace KDDockWidgets;
 
@@ -52,6 +56,7 @@ public:
 
     QString name;
     QStringList affinities;
+    AffinitySet affinitySet;
     const MainWindowOptions m_options;
 };
 
@@ -74,7 +79,7 @@ void MainWindowBase::addDockWidgetAsTab(DockWidgetBase *widget)
     Q_ASSERT(widget);
     qCDebug(addwidget) << Q_FUNC_INFO << widget;
 
-    if (!DockRegistry::self()->affinitiesMatch(d->affinities, widget->affinities())) {
+    if (!DockRegistry::self()->affinitiesMatch(d->affinitySet, widget->affinitySet())) {
         qWarning() << Q_FUNC_INFO << "Refusing to dock widget with incompatible affinity."
                    << widget->affinities() << affinities();
         return;
@@ -102,6 +107,61 @@ void MainWindowBase::addDockWidget(DockWidgetBase *dw, Location location, DockWi
     dropArea()->addDockWidget(dw, location, relativeTo, option);
 }
 
+bool MainWindowBase::addDockWidgetsDeferringGeometry(const QVector<DockPlacement> &placements)
+{
+    // Validate everything first, so we don't end up with half of the list docked
+    QSet<const DockWidgetBase*> docked; // The ones which will get a frame, so can be used as reference
+    QSet<const DockWidgetBase*> seen;
+    docked.reserve(placements.size());
+    seen.reserve(placements.size());
+    for (const DockPlacement &placement : placements) {
+        DockWidgetBase *dw = placement.dockWidget;
+        if (!dw || seen.contains(dw)) {
+            qWarning() << Q_FUNC_INFO << "Null or repeated dock widget" << dw;
+            return false;
+        }
+
+        if (dw->options() & DockWidgetBase::Option_NotDockable) {
+            qWarning() << Q_FUNC_INFO << "Refusing to dock non-dockable widget" << dw;
+            return false;
+        }
+
+        if (!DockRegistry::self()->affinitiesMatch(d->affinitySet, dw->affinitySet())) {
+            qWarning() << Q_FUNC_INFO << "Refusing to dock widget with incompatible affinity."
+                       << dw->affinities() << affinities();
+            return false;
+        }
+
+        DockWidgetBase *reference = placement.tabInto ? placement.tabInto : placement.relativeTo;
+        if (reference == dw || (!placement.tabInto && placement.location == Location_None)) {
+            qWarning() << Q_FUNC_INFO << "Invalid parameters" << dw << reference << placement.location;
+            return false;
+        }
+
+        if (reference && !docked.contains(reference) && !dropArea()->contains(reference)) {
+            qWarning() << Q_FUNC_INFO << "Reference dock widget" << reference
+                       << "isn't in this main window nor previously added as visible";
+            return false;
+        }
+
+        seen.insert(dw);
+        if (!(placement.option & AddingOption_StartHidden))
+            docked.insert(dw);
+    }
+
+    // Items are still inserted and sized one by one, as addDockWidget() does. Only the geometry is
+    // deferred: resizing the widgets and updating the separators is done once, when the transaction ends.
+    Layouting::LayoutTransaction transaction(multiSplitter()->rootItem());
+    for (const DockPlacement &placement : placements) {
+        if (placement.tabInto)
+            placement.tabInto->addDockWidgetAsTab(placement.dockWidget, placement.option);
+        else
+            dropArea()->addDockWidget(placement.dockWidget, placement.location, placement.relativeTo, placement.option);
+    }
+
+    return true;
+}
+
 QString MainWindowBase::uniqueName() const
 {
     return d->name;
@@ -133,6 +193,7 @@ void MainWindowBase::setAffinities(const QStringList &affinityNames)
     }
 
     d->affinities = affinities;
+    d->affinitySet = AffinitySet(affinities);
 }
 
 QStringList MainWindowBase::affinities() const
@@ -140,6 +201,11 @@ QStringList MainWindowBase::affinities() const
     return d->affinities;
 }
 
+const AffinitySet &MainWindowBase::affinitySet() const
+{
+    return d->affinitySet;
+}
+
 void MainWindowBase::layoutEqually()
 {
     dropArea()->layoutEqually();
@@ -164,7 +230,7 @@ void MainWindowBase::setUniqueName(const QString &uniqueName)
     }
 }
 
-bool MainWindowBase::deserialize(const LayoutSaver::MainWindow &mw)
+bool MainWindowBase::deserialize(const LayoutSaver::MainWindow &mw, const QHash<QString, Frame *> &reusedFrames)
 {
     if (mw.options != options()) {
         qWarning() << Q_FUNC_INFO << "Refusing to restore MainWindow with different options"
@@ -177,9 +243,10 @@ bool MainWindowBase::deserialize(const LayoutSaver::MainWindow &mw)
                    << "; to" << mw.affinities;
 
         d->affinities = mw.affinities;
+        d->affinitySet = AffinitySet(mw.affinities);
     }
 
-    return dropArea()->deserialize(mw.multiSplitterLayout);
+    return dropArea()->deserialize(mw.multiSplitterLayout, reusedFrames);
 }
 
 LayoutSaver::MainWindow MainWindowBase::serialize() const
@@ -43,6 +43,8 @@ class Frame;
 class DropArea;
 class MultiSplitter;
 class DropAreaWithCentralFrame;
+class DockRegistry;
+class AffinitySet;
 
 /**
  * @brief The MainWindow base-class. MainWindow and MainWindowBase are only
@@ -60,6 +62,29 @@ class DOCKS_EXPORT MainWindowBase : public QMainWindow
     Q_OBJECT
 public:
     typedef QVector<MainWindowBase*> List;
+
+    ///@brief Describes where addDockWidgetsDeferringGeometry() puts a dock widget
+    struct DockPlacement
+    {
+        explicit DockPlacement(DockWidgetBase *dockWidget = nullptr,
+                               KDDockWidgets::Location location = KDDockWidgets::Location_None,
+                               DockWidgetBase *relativeTo = nullptr, DockWidgetBase *tabInto = nullptr,
+                               KDDockWidgets::AddingOption option = KDDockWidgets::AddingOption())
+            : dockWidget(dockWidget)
+            , location(location)
+            , relativeTo(relativeTo)
+            , tabInto(tabInto)
+            , option(option)
+        {
+        }
+
+        DockWidgetBase *dockWidget;
+        KDDockWidgets::Location location;
+        DockWidgetBase *relativeTo;
+        ///@brief If set then dockWidget is added as a tab of tabInto, and location and relativeTo are ignored
+        DockWidgetBase *tabInto;
+        KDDockWidgets::AddingOption option;
+    };
     explicit MainWindowBase(const QString &uniqueName, MainWindowOptions options = MainWindowOption_HasCentralFrame,
                             QWidgetOrQuick *parent = nullptr, Qt::WindowFlags flags = Qt::WindowFlags());
 
@@ -85,6 +110,25 @@ public:
                        KDDockWidgets::Location location,
                        DockWidgetBase *relativeTo = nullptr, AddingOption option = KDDockWidgets::AddingOption());
 
+    /**
+     * @brief Docks many dock widgets, deferring the widget geometries until all are docked.
+     * Use it when building the initial UI.
+     *
+     * Equivalent to calling addDockWidget(), or DockWidgetBase::addDockWidgetAsTab() for the
+     * placements with tabInto, for each placement in order, inside a single layout transaction.
+     *
+     * Only the geometry is deferred: the frame widgets are resized, the separators created and
+     * positioned, and the geometry signals emitted once, at the end. The layout itself isn't built
+     * in one pass, each placement is inserted and sized like addDockWidget() does, so that part
+     * still costs the same as docking one by one.
+     *
+     * relativeTo and tabInto must either be already docked in this main window or come earlier in
+     * @p placements. The whole list is validated first, if something is wrong nothing is docked.
+     *
+     * @return true on success, false if @p placements was rejected
+     */
+    bool addDockWidgetsDeferringGeometry(const QVector<DockPlacement> &placements);
+
     /**
      * @brief Returns the unique name that was passed via constructor.
      *        Used internally by the save/restore mechanism.
@@ -147,11 +191,17 @@ Q_SIGNALS:
     void uniqueNameChanged();
 
 private:
+    ///@brief returns the interned affinities(), for fast matching
+    const AffinitySet &affinitySet() const;
+
     class Private;
     Private *const d;
 
     friend class LayoutSaver;
-    bool deserialize(const LayoutSaver::MainWindow &);
+    friend class DockRegistry;
+    friend class DropArea;
+    bool deserialize(const LayoutSaver::MainWindow &,
+                     const QHash<QString, Frame *> &reusedFrames = QHash<QString, Frame *>());
     LayoutSaver::MainWindow serialize() const;
 };
 
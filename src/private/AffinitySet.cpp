@@ -0,0 +1,74 @@
+/*
+  This file is part of KDDockWidgets.
+
+  Copyright (C) 2020 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+  Author: Sérgio Martins <sergio.martins@kdab.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "AffinitySet_p.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+using namespace KDDockWidgets;
+
+static const int s_numBits = 64;
+
+/// Returns the id of affinity @p name, adding it to the table if it's new.
+/// Ids are never recycled, there's usually just a handful of different affinities in an app.
+static int internAffinity(const QString &name)
+{
+    static QHash<QString, int> s_ids;
+
+    auto it = s_ids.constFind(name);
+    if (it != s_ids.constEnd())
+        return it.value();
+
+    const int id = s_ids.size();
+    s_ids.insert(name, id);
+    return id;
+}
+
+AffinitySet::AffinitySet(const QStringList &names)
+{
+    for (const QString &name : names) {
+        const int id = internAffinity(name);
+        if (id < s_numBits) {
+            m_bits |= quint64(1) << id;
+        } else {
+            auto it = std::lower_bound(m_overflow.begin(), m_overflow.end(), id);
+            if (it == m_overflow.end() || *it != id)
+                m_overflow.insert(it, id);
+        }
+    }
+}
+
+bool AffinitySet::overflowIntersects(const AffinitySet &other) const
+{
+    auto it1 = m_overflow.cbegin();
+    auto it2 = other.m_overflow.cbegin();
+    while (it1 != m_overflow.cend() && it2 != other.m_overflow.cend()) {
+        if (*it1 == *it2)
+            return true;
+        else if (*it1 < *it2)
+            ++it1;
+        else
+            ++it2;
+    }
+
+    return false;
+}
@@ -0,0 +1,89 @@
+/*
+  This file is part of KDDockWidgets.
+
+  Copyright (C) 2020 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+  Author: Sérgio Martins <sergio.martins@kdab.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file Compact representation of a list of affinity names.
+ *
+ * @author Sérgio Martins \<sergio.martins@kdab.com\>
+ */
+
+#ifndef KDDOCKWIDGETS_AFFINITYSET_P_H
+#define KDDOCKWIDGETS_AFFINITYSET_P_H
+
+#include "docks_export.h"
+
+#include <QStringList>
+#include <QVector>
+
+namespace KDDockWidgets {
+
+/**
+ * @brief A set of affinity names, for fast matching
+ *
+ * Affinity names are interned into a global table. The first 64 names get one bit each, the rest
+ * go into a small sorted vector. So matching two sets is usually just an AND.
+ *
+ * The QStringList getters, like DockWidgetBase::affinities(), are still the public API, this is
+ * only what's used for matching.
+ */
+class DOCKS_EXPORT_FOR_UNIT_TESTS AffinitySet
+{
+public:
+    AffinitySet() = default;
+    explicit AffinitySet(const QStringList &names);
+
+    ///@brief returns whether there's no affinity
+    bool isEmpty() const
+    {
+        return m_bits == 0 && m_overflow.isEmpty();
+    }
+
+    ///@brief returns whether both sets are empty or they have at least one affinity in common
+    /// Same semantics as DockRegistry::affinitiesMatch()
+    bool matches(const AffinitySet &other) const
+    {
+        if (m_bits & other.m_bits)
+            return true;
+
+        if (isEmpty() && other.isEmpty())
+            return true;
+
+        return !m_overflow.isEmpty() && !other.m_overflow.isEmpty() && overflowIntersects(other);
+    }
+
+    bool operator==(const AffinitySet &other) const
+    {
+        return m_bits == other.m_bits && m_overflow == other.m_overflow;
+    }
+
+    bool operator!=(const AffinitySet &other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    bool overflowIntersects(const AffinitySet &other) const;
+    quint64 m_bits = 0;
+    QVector<int> m_overflow; // Sorted ids which don't fit in m_bits
+};
+
+}
+
+#endif
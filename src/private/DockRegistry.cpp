@@ -30,9 +30,23 @@
 #include <QDebug>
 #include <QApplication>
 #include <QWindow>
+#include <QSet>
+
+#include <memory>
+#include <vector>
 
 using namespace KDDockWidgets;
 
+static QSet<QString> toSet(const QStringList &names)
+{
+    QSet<QString> result;
+    result.reserve(names.size());
+    for (const QString &name : names)
+        result.insert(name);
+
+    return result;
+}
+
 DockRegistry::DockRegistry(QObject *parent)
     : QObject(parent)
 {
@@ -82,17 +96,12 @@ bool DockRegistry::isProcessingAppQuitEvent() const
 
 bool DockRegistry::affinitiesMatch(const QStringList &affinities1, const QStringList &affinities2) const
 {
-    if (affinities1.isEmpty() && affinities2.isEmpty())
-        return true;
-
-    for (const QString &a1 : affinities1) {
-        for (const QString &a2 : affinities2) {
-            if (a1 == a2)
-                return true;
-        }
-    }
+    return affinitiesMatch(AffinitySet(affinities1), AffinitySet(affinities2));
+}
 
-    return false;
+bool DockRegistry::affinitiesMatch(const AffinitySet &affinities1, const AffinitySet &affinities2) const
+{
+    return affinities1.matches(affinities2);
 }
 
 QStringList DockRegistry::mainWindowsNames() const
@@ -119,9 +128,9 @@ MainWindowBase::List DockRegistry::mainWindowsWithAffinity(const QStringList &af
 {
     MainWindowBase::List result;
 
+    const AffinitySet affinitySet(affinities);
     for (auto mw : m_mainWindows) {
-        const QStringList mwAffinities = mw->affinities();
-        if (affinitiesMatch(mwAffinities, affinities))
+        if (affinitiesMatch(mw->affinitySet(), affinitySet))
             result << mw;
     }
 
@@ -130,11 +139,27 @@ MainWindowBase::List DockRegistry::mainWindowsWithAffinity(const QStringList &af
 
 MultiSplitter *DockRegistry::layoutForItem(const Layouting::Item *item) const
 {
-    if (!item->hostWidget())
-        return nullptr;
+    // Every Item in a tree shares the root's host widget, which is the MultiSplitter owning it
+    auto layout = item->hostWidget() ? qobject_cast<MultiSplitter*>(item->hostWidget()->asQWidget())
+                                     : nullptr;
 
-    if (auto ms = qobject_cast<MultiSplitter*>(item->hostWidget()->asQWidget()))
-        return ms;
+#ifdef DOCKS_DEVELOPER_MODE
+    // Can cause slowdown, so just use it in developer mode.
+    MultiSplitter *containingLayout = findLayoutContaining(item);
+    if (containingLayout && containingLayout != layout)
+        qWarning() << Q_FUNC_INFO << "Item" << item << "is in layout" << containingLayout
+                   << "but its host is" << layout;
+#endif
+
+    return layout;
+}
+
+MultiSplitter *DockRegistry::findLayoutContaining(const Layouting::Item *item) const
+{
+    for (MultiSplitter *layout : m_layouts) {
+        if (layout->rootItem()->contains_recursive(item))
+            return layout;
+    }
 
     return nullptr;
 }
@@ -160,27 +185,64 @@ DockRegistry *DockRegistry::self()
 
 void DockRegistry::registerDockWidget(DockWidgetBase *dock)
 {
-    if (dock->uniqueName().isEmpty()) {
+    const QString name = dock->uniqueName();
+    if (name.isEmpty()) {
         qWarning() << Q_FUNC_INFO << "DockWidget" << dock << " doesn't have an ID";
-    } else if (auto other = dockByName(dock->uniqueName())) {
-        qWarning() << Q_FUNC_INFO << "Another DockWidget" << other << "with name" << dock->uniqueName() << " already exists." << dock;
+    } else if (auto other = dockByName(name)) {
+        qWarning() << Q_FUNC_INFO << "Another DockWidget" << other << "with name" << name << " already exists." << dock;
+    } else {
+        m_dockWidgetsByName.insert(name, dock);
     }
 
     m_dockWidgets << dock;
+
+    m_guestConnections.insert(dock, connect(dock, &DockWidgetBase::widgetChanged, this, [this, dock] (QWidget *guest) {
+        onDockWidgetGuestChanged(dock, guest);
+    }));
 }
 
 void DockRegistry::unregisterDockWidget(DockWidgetBase *dock)
 {
+    disconnect(m_guestConnections.take(dock));
     m_dockWidgets.removeOne(dock);
+    onDockWidgetGuestChanged(dock, nullptr);
+
+    const QString name = dock->uniqueName();
+    if (m_dockWidgetsByName.value(name) == dock) {
+        m_dockWidgetsByName.remove(name);
+        // Another dock widget with the same name might have been registered meanwhile
+        for (auto other : qAsConst(m_dockWidgets)) {
+            if (other->uniqueName() == name) {
+                m_dockWidgetsByName.insert(name, other);
+                break;
+            }
+        }
+    }
+
     maybeDelete();
 }
 
+void DockRegistry::onDockWidgetGuestChanged(DockWidgetBase *dock, QWidget *guest)
+{
+    QWidget *previousGuest = m_guestsByDockWidget.take(dock);
+    if (previousGuest && m_dockWidgetsByGuest.value(previousGuest) == dock)
+        m_dockWidgetsByGuest.remove(previousGuest);
+
+    if (guest) {
+        m_dockWidgetsByGuest.insert(guest, dock);
+        m_guestsByDockWidget.insert(dock, guest);
+    }
+}
+
 void DockRegistry::registerMainWindow(MainWindowBase *mainWindow)
 {
-    if (mainWindow->uniqueName().isEmpty()) {
+    const QString name = mainWindow->uniqueName();
+    if (name.isEmpty()) {
         qWarning() << Q_FUNC_INFO << "MainWindow" << mainWindow << " doesn't have an ID";
-    } else if (auto other = mainWindowByName(mainWindow->uniqueName())) {
-        qWarning() << Q_FUNC_INFO << "Another MainWindow" << other << "with name" << mainWindow->uniqueName() << " already exists." << mainWindow;
+    } else if (auto other = mainWindowByName(name)) {
+        qWarning() << Q_FUNC_INFO << "Another MainWindow" << other << "with name" << name << " already exists." << mainWindow;
+    } else {
+        m_mainWindowsByName.insert(name, mainWindow);
     }
 
     m_mainWindows << mainWindow;
@@ -189,17 +251,31 @@ void DockRegistry::registerMainWindow(MainWindowBase *mainWindow)
 void DockRegistry::unregisterMainWindow(MainWindowBase *mainWindow)
 {
     m_mainWindows.removeOne(mainWindow);
+
+    const QString name = mainWindow->uniqueName();
+    if (m_mainWindowsByName.value(name) == mainWindow) {
+        m_mainWindowsByName.remove(name);
+        for (auto other : qAsConst(m_mainWindows)) {
+            if (other->uniqueName() == name) {
+                m_mainWindowsByName.insert(name, other);
+                break;
+            }
+        }
+    }
+
     maybeDelete();
 }
 
 void DockRegistry::registerNestedWindow(FloatingWindow *window)
 {
     m_nestedWindows << window;
+    m_floatingWindowsByHandleDirty = true;
 }
 
 void DockRegistry::unregisterNestedWindow(FloatingWindow *window)
 {
     m_nestedWindows.removeOne(window);
+    m_floatingWindowsByHandleDirty = true;
     maybeDelete();
 }
 
@@ -225,22 +301,12 @@ void DockRegistry::unregisterFrame(Frame *frame)
 
 DockWidgetBase *DockRegistry::dockByName(const QString &name) const
 {
-    for (auto dock : qAsConst(m_dockWidgets)) {
-        if (dock->uniqueName() == name)
-            return dock;
-    }
-
-    return nullptr;
+    return m_dockWidgetsByName.value(name);
 }
 
 MainWindowBase *DockRegistry::mainWindowByName(const QString &name) const
 {
-    for (auto mainWindow : qAsConst(m_mainWindows)) {
-        if (mainWindow->uniqueName() == name)
-            return mainWindow;
-    }
-
-    return nullptr;
+    return m_mainWindowsByName.value(name);
 }
 
 DockWidgetBase *DockRegistry::dockWidgetForGuest(QWidget *guest) const
@@ -248,12 +314,9 @@ DockWidgetBase *DockRegistry::dockWidgetForGuest(QWidget *guest) const
     if (!guest)
         return nullptr;
 
-    for (DockWidgetBase *dw : m_dockWidgets) {
-        if (dw->widget() == guest)
-            return dw;
-    }
-
-    return nullptr;
+    // The guest might have been deleted and its address reused, so double-check
+    DockWidgetBase *dw = m_dockWidgetsByGuest.value(guest);
+    return dw && dw->widget() == guest ? dw : nullptr;
 }
 
 bool DockRegistry::isSane() const
@@ -302,8 +365,9 @@ const DockWidgetBase::List DockRegistry::dockWidgets(const QStringList &names)
     DockWidgetBase::List result;
     result.reserve(names.size());
 
+    const QSet<QString> nameSet = toSet(names);
     for (auto dw : qAsConst(m_dockWidgets)) {
-        if (names.contains(dw->uniqueName()))
+        if (nameSet.contains(dw->uniqueName()))
             result.push_back(dw);
     }
 
@@ -315,8 +379,9 @@ const MainWindowBase::List DockRegistry::mainWindows(const QStringList &names)
     MainWindowBase::List result;
     result.reserve(names.size());
 
+    const QSet<QString> nameSet = toSet(names);
     for (auto mw : qAsConst(m_mainWindows)) {
-        if (names.contains(mw->uniqueName()))
+        if (nameSet.contains(mw->uniqueName()))
             result.push_back(mw);
     }
 
@@ -366,12 +431,28 @@ const QVector<FloatingWindow *> DockRegistry::nestedwindows() const
 
 FloatingWindow *DockRegistry::floatingWindowForHandle(QWindow *windowHandle) const
 {
+    if (m_floatingWindowsByHandleDirty)
+        rebuildFloatingWindowsByHandle();
+
+    FloatingWindow *fw = m_floatingWindowsByHandle.value(windowHandle);
+    if (fw && fw->windowHandle() != windowHandle) {
+        // The handle was recreated behind our back
+        rebuildFloatingWindowsByHandle();
+        fw = m_floatingWindowsByHandle.value(windowHandle);
+    }
+
+    return fw;
+}
+
+void DockRegistry::rebuildFloatingWindowsByHandle() const
+{
+    m_floatingWindowsByHandle.clear();
     for (FloatingWindow *fw : m_nestedWindows) {
-        if (fw->windowHandle() == windowHandle)
-            return fw;
+        if (QWindow *windowHandle = fw->windowHandle())
+            m_floatingWindowsByHandle.insert(windowHandle, fw);
     }
 
-    return nullptr;
+    m_floatingWindowsByHandleDirty = false;
 }
 
 QVector<QWidget *> DockRegistry::topLevels(bool excludeFloatingDocks) const
@@ -404,18 +485,69 @@ void DockRegistry::clear(const DockWidgetBase::List &dockWidgets,
                          const MainWindowBase::List &mainWindows,
                          QStringList affinities)
 {
+    ClearJob job(dockWidgets, mainWindows, affinities);
+    while (!job.isDone())
+        job.step();
+}
+
+DockRegistry::ClearJob::ClearJob(const DockWidgetBase::List &dockWidgets,
+                                 const MainWindowBase::List &mainWindows,
+                                 const QStringList &affinities)
+{
+    DockRegistry *registry = DockRegistry::self();
+    const AffinitySet affinitySet(affinities);
+
+    m_roots.reserve(mainWindows.size());
+    for (auto mw : qAsConst(mainWindows)) {
+        if (affinities.isEmpty() || registry->affinitiesMatch(affinitySet, mw->affinitySet()))
+            m_roots.push_back(mw->multiSplitter()->rootItem());
+    }
+
+    m_dockWidgets.reserve(dockWidgets.size());
     for (auto dw : qAsConst(dockWidgets)) {
-        if (affinities.isEmpty() || affinitiesMatch(affinities, dw->affinities())) {
+        if (affinities.isEmpty() || registry->affinitiesMatch(affinitySet, dw->affinitySet()))
+            m_dockWidgets.push_back(dw);
+    }
+
+    // Closing each dock widget would turn its item into a placeholder and make the neighbours grow,
+    // all of which is thrown away by the clear() in the last step. So suspend that, and also only
+    // apply the widget geometries and separators once, when we're done.
+    m_transactions.reserve(size_t(m_roots.size()));
+    for (Layouting::ItemContainer *root : qAsConst(m_roots)) {
+        m_transactions.emplace_back(new Layouting::LayoutTransaction(root));
+        root->aboutToClear();
+    }
+}
+
+DockRegistry::ClearJob::~ClearJob()
+{
+    // The main windows can't be left half cleared, with aboutToClear() set. So finish if we were
+    // abandoned, for example by a cancelled async restore, which restores a whole layout next anyway.
+    while (!m_done)
+        step();
+}
+
+void DockRegistry::ClearJob::step()
+{
+    if (m_done)
+        return;
+
+    if (m_index < m_dockWidgets.size()) {
+        // Might have been deleted since the previous step, if we're time sliced
+        if (DockWidgetBase *dw = m_dockWidgets.at(m_index++)) {
             dw->forceClose();
             dw->lastPositions().removePlaceholders();
         }
+        return;
     }
 
-    for (auto mw : qAsConst(mainWindows)) {
-        if (affinities.isEmpty() || affinitiesMatch(affinities, mw->affinities())) {
-            mw->multiSplitter()->rootItem()->clear();
-        }
+    for (Layouting::ItemContainer *root : qAsConst(m_roots)) {
+        if (root)
+            root->clear();
     }
+
+    m_transactions.clear();
+    m_done = true;
 }
 
 void DockRegistry::ensureAllFloatingWidgetsAreMorphed()
@@ -433,6 +565,10 @@ bool DockRegistry::eventFilter(QObject *watched, QEvent *event)
         qApp->sendEvent(qApp, event);
         m_isProcessingAppQuitEvent = false;
         return true;
+    } else if (event->type() == QEvent::PlatformSurface) {
+        // A QWindow was created or is going away, the handle index might be stale
+        if (qobject_cast<QWindow*>(watched))
+            m_floatingWindowsByHandleDirty = true;
     } else if (event->type() == QEvent::Expose) {
         if (auto windowHandle = qobject_cast<QWindow*>(watched)) {
             if (FloatingWindow *fw = floatingWindowForHandle(windowHandle)) {
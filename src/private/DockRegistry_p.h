@@ -24,9 +24,20 @@
 #include "DockWidgetBase.h"
 #include "MainWindowBase.h"
 #include "FloatingWindow_p.h"
+#include "AffinitySet_p.h"
 
 #include <QVector>
 #include <QObject>
+#include <QHash>
+#include <QPointer>
+
+#include <memory>
+#include <vector>
+
+namespace Layouting {
+class ItemContainer;
+class LayoutTransaction;
+}
 
 /**
  * DockRegistry is a singleton that knows about all DockWidgets.
@@ -118,6 +129,33 @@ public:
                const MainWindowBase::List &mainWindows,
                QStringList affinities);
 
+    /**
+     * @brief Does the same as clear(), but one dock widget per step(), so restores can be time sliced
+     *
+     * The main windows are cleared by the last step. Until then their layouts are in a transaction,
+     * so closing the dock widgets doesn't relayout them.
+     */
+    class ClearJob
+    {
+    public:
+        ClearJob(const DockWidgetBase::List &dockWidgets, const MainWindowBase::List &mainWindows,
+                 const QStringList &affinities);
+        ~ClearJob();
+
+        ///@brief Closes the next dock widget, or clears the main windows if they're all closed
+        void step();
+        bool isDone() const { return m_done; }
+        int numSteps() const { return m_dockWidgets.size() + 1; }
+
+    private:
+        Q_DISABLE_COPY(ClearJob)
+        QVector<QPointer<DockWidgetBase>> m_dockWidgets;
+        QVector<QPointer<Layouting::ItemContainer>> m_roots;
+        std::vector<std::unique_ptr<Layouting::LayoutTransaction>> m_transactions;
+        int m_index = 0;
+        bool m_done = false;
+    };
+
     /**
      * @brief Ensures that all floating DockWidgets have a FloatingWindow as a window.
      *
@@ -153,15 +191,18 @@ public:
      */
     MainWindowBase::List mainWindowsWithAffinity(const QStringList &affinities) const;
 
-    // TODO: docs
+    ///@brief returns the layout containing @p item. O(1), as it's the item's host widget.
     MultiSplitter* layoutForItem(const Layouting::Item *) const;
 
-    // TODO: docs
+    ///@brief returns whether @p item is in a layout that belongs to a MainWindow
     bool itemIsInMainWindow(const Layouting::Item *) const;
 
 
     bool affinitiesMatch(const QStringList &affinities1, const QStringList &affinities2) const;
 
+    ///@brief overload taking interned affinities. Prefer this one in hot paths, it doesn't compare strings.
+    bool affinitiesMatch(const AffinitySet &affinities1, const AffinitySet &affinities2) const;
+
     /// @brief Returns a list of all known main window unique names
     QStringList mainWindowsNames() const;
 
@@ -173,11 +214,28 @@ protected:
 private:
     explicit DockRegistry(QObject *parent = nullptr);
     void maybeDelete();
+    void onDockWidgetGuestChanged(DockWidgetBase *, QWidget *guest);
+    void rebuildFloatingWindowsByHandle() const;
+    ///@brief slow path of layoutForItem(), searching every layout. Used to cross-check it.
+    MultiSplitter *findLayoutContaining(const Layouting::Item *) const;
     bool m_isProcessingAppQuitEvent = false;
     DockWidgetBase::List m_dockWidgets;
     MainWindowBase::List m_mainWindows;
+
+    // Indexes for the lookups above. m_dockWidgets and m_mainWindows stay the source of truth,
+    // and keep the registration order. With duplicate names the first registered one wins.
+    QHash<QString, DockWidgetBase*> m_dockWidgetsByName;
+    QHash<QString, MainWindowBase*> m_mainWindowsByName;
+    QHash<QWidget*, DockWidgetBase*> m_dockWidgetsByGuest;
+    QHash<DockWidgetBase*, QWidget*> m_guestsByDockWidget;
+    QHash<DockWidgetBase*, QMetaObject::Connection> m_guestConnections;
     Frame::List m_frames;
     QVector<FloatingWindow*> m_nestedWindows;
+
+    // Index for floatingWindowForHandle(). Qt creates the QWindow handles lazily, so it's
+    // rebuilt on the next lookup whenever a floating window or a platform window comes or goes.
+    mutable QHash<QWindow*, FloatingWindow*> m_floatingWindowsByHandle;
+    mutable bool m_floatingWindowsByHandleDirty = true;
     QVector<MultiSplitter*> m_layouts;
 };
 
@@ -26,6 +26,7 @@
 #include "WidgetResizeHandler_p.h"
 #include "Utils_p.h"
 #include "DockRegistry_p.h"
+#include "AffinitySet_p.h"
 
 #include <QMouseEvent>
 #include <QApplication>
@@ -181,6 +182,10 @@ void StateDragging::onEntry(QEvent *)
             dw->saveLastFloatingGeometry();
     }
 
+    // Separators might have moved since the last drag, start with fresh drop rects
+    for (MultiSplitter *layout : DockRegistry::self()->layouts())
+        layout->invalidateDropRectCache();
+
     q->m_windowBeingDragged = q->m_draggable->makeWindow();
     if (q->m_windowBeingDragged) {
         qCDebug(state) << "StateDragging entered. m_draggable=" << q->m_draggable << "; m_windowBeingDragged=" << q->m_windowBeingDragged->floatingWindow();
@@ -525,12 +530,12 @@ QWidgetOrQuick *DragController::qtTopLevelUnderCursor() const
 }
 
 static DropArea* deepestDropAreaInTopLevel(QWidget *topLevel, QPoint globalPos,
-                                           const QStringList &affinities)
+                                           const AffinitySet &affinities)
 {
     auto w = topLevel->childAt(topLevel->mapFromGlobal(globalPos));
     while (w) {
         if (auto dt = qobject_cast<DropArea *>(w)) {
-            if (DockRegistry::self()->affinitiesMatch(dt->affinities(), affinities))
+            if (DockRegistry::self()->affinitiesMatch(dt->affinitySet(), affinities))
                 return dt;
         }
         w = w->parentWidget();
@@ -545,15 +550,15 @@ DropArea *DragController::dropAreaUnderCursor() const
     if (!topLevel)
         return nullptr;
 
-    const QStringList affinities = m_windowBeingDragged->floatingWindow()->affinities();
+    const AffinitySet affinities = m_windowBeingDragged->floatingWindow()->affinitySet();
 
     if (auto dt = qobject_cast<DropArea *>(topLevel)) {
-        if (DockRegistry::self()->affinitiesMatch(dt->affinities(), affinities))
+        if (DockRegistry::self()->affinitiesMatch(dt->affinitySet(), affinities))
             return dt;
     }
 
     if (auto fw = qobject_cast<FloatingWindow *>(topLevel)) {
-        if (DockRegistry::self()->affinitiesMatch(fw->affinities(), affinities))
+        if (DockRegistry::self()->affinitiesMatch(fw->affinitySet(), affinities))
             return fw->dropArea();
     }
 
@@ -565,7 +570,7 @@ DropArea *DragController::dropAreaUnderCursor() const
     if (auto dock = qobject_cast<DockWidgetBase *>(topLevel)) {
         FloatingWindow *fw = dock->morphIntoFloatingWindow();
         m_windowBeingDragged->floatingWindow()->raise();
-        if (DockRegistry::self()->affinitiesMatch(fw->affinities(), affinities))
+        if (DockRegistry::self()->affinitiesMatch(fw->affinitySet(), affinities))
             return fw->dropArea();
     }
 
@@ -29,6 +29,7 @@
 #include "MainWindowBase.h"
 #include "multisplitter/Item_p.h"
 #include "DockRegistry_p.h"
+#include "AffinitySet_p.h"
 #include "private/widgets/FrameWidget_p.h"
 
 // #include "indicators/AnimatedIndicators_p.h"
@@ -74,17 +75,14 @@ Frame::List DropArea::frames() const
 
 Frame *DropArea::frameContainingPos(QPoint globalPos) const
 {
-    const Layouting::Item::List &items = this->items();
-    for (Layouting::Item *item : items) {
-        auto frame = static_cast<Frame*>(item->guestAsQObject());
-        if (!frame || !frame->QWidget::isVisible()) {
-            continue;
-        }
-
-        if (frame->containsMouse(globalPos))
-            return frame;
-    }
-    return nullptr;
+    // Our coordinates are the same as the root item's
+    const QPoint localPos = Layouting::Widget_qwidget::mapFromGlobal(globalPos);
+    Layouting::Item *item = rootItem()->itemAt_recursive(localPos);
+    auto frame = item ? static_cast<Frame*>(item->guestAsQObject()) : nullptr;
+    if (!frame || !frame->QWidget::isVisible())
+        return nullptr;
+
+    return frame;
 }
 
 Layouting::Item *DropArea::centralFrame() const
@@ -158,6 +156,17 @@ QStringList DropArea::affinities() const
     return {};
 }
 
+AffinitySet DropArea::affinitySet() const
+{
+    if (auto mw = mainWindow()) {
+        return mw->affinitySet();
+    } else if (auto fw = floatingWindow()) {
+        return fw->affinitySet();
+    }
+
+    return {};
+}
+
 void DropArea::layoutParentContainerEqually(DockWidgetBase *dw)
 {
     Layouting::Item *item = itemForFrame(dw->frame());
@@ -279,12 +288,13 @@ void DropArea::removeHover()
 {
     m_dropIndicatorOverlay->setWindowBeingDragged(nullptr);
     m_dropIndicatorOverlay->setCurrentDropLocation(DropIndicatorOverlayInterface::DropLocation_None);
+    invalidateDropRectCache();
 }
 
 template<typename T>
 bool DropArea::validateAffinity(T *window) const
 {
-    if (!DockRegistry::self()->affinitiesMatch(window->affinities(), affinities())) {
+    if (!DockRegistry::self()->affinitiesMatch(window->affinitySet(), affinitySet())) {
         // Commented the warning, so we don't warn when hovering over
         //qWarning() << Q_FUNC_INFO << "Refusing to dock widget with incompatible affinity."
                    //<< window->affinityName() << affinityName();
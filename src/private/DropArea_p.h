@@ -40,6 +40,7 @@ class Frame;
 class Draggable;
 class DropIndicatorOverlayInterface;
 struct WindowBeingDragged;
+class AffinitySet;
 
 /**
  * @brief A MultiSplitter with support for drop indicators when hovering over.
@@ -58,6 +59,10 @@ public:
     int numFrames() const;
     Frame::List frames() const;
 
+    ///@brief Returns the visible frame under @p globalPos, or nullptr.
+    ///Uses the layout's spatial lookup, so it's cheap enough to call on every mouse move.
+    Frame *frameContainingPos(QPoint globalPos) const;
+
     Layouting::Item *centralFrame() const;
     DropIndicatorOverlayInterface *dropIndicatorOverlay() const { return m_dropIndicatorOverlay; }
     void addDockWidget(DockWidgetBase *, KDDockWidgets::Location location, DockWidgetBase *relativeTo, AddingOption option = {});
@@ -65,6 +70,7 @@ public:
     bool contains(DockWidgetBase *) const;
 
     QStringList affinities() const;
+    AffinitySet affinitySet() const;
     void layoutParentContainerEqually(DockWidgetBase *);
 private:
     Q_DISABLE_COPY(DropArea)
@@ -74,7 +80,6 @@ private:
     friend class AnimatedIndicators;
     template <typename T>
     bool validateAffinity(T *) const;
-    Frame *frameContainingPos(QPoint globalPos) const;
     bool m_inDestructor = false;
     QString m_affinityName;
     DropIndicatorOverlayInterface *m_dropIndicatorOverlay = nullptr;
@@ -28,6 +28,7 @@
 #include "Utils_p.h"
 #include "WidgetResizeHandler_p.h"
 #include "DockRegistry_p.h"
+#include "AffinitySet_p.h"
 #include "Config.h"
 #include "FrameworkWidgetFactory.h"
 
@@ -348,6 +349,12 @@ QStringList FloatingWindow::affinities() const
     return frames.isEmpty() ? QStringList() : frames.constFirst()->affinities();
 }
 
+AffinitySet FloatingWindow::affinitySet() const
+{
+    auto frames = this->frames();
+    return frames.isEmpty() ? AffinitySet() : frames.constFirst()->affinitySet();
+}
+
 void FloatingWindow::updateTitleAndIcon()
 {
     QString title;
@@ -388,9 +395,9 @@ void FloatingWindow::onCloseEvent(QCloseEvent *e)
     }
 }
 
-bool FloatingWindow::deserialize(const LayoutSaver::FloatingWindow &fw)
+bool FloatingWindow::deserialize(const LayoutSaver::FloatingWindow &fw, const QHash<QString, Frame *> &reusedFrames)
 {
-    if (dropArea()->deserialize(fw.multiSplitterLayout)) {
+    if (dropArea()->deserialize(fw.multiSplitterLayout, reusedFrames)) {
         updateTitleBarVisibility();
         show();
         return true;
@@ -38,6 +38,7 @@ class MainWindowBase;
 class DropArea;
 class Frame;
 class MultiSplitter;
+class AffinitySet;
 
 class DOCKS_EXPORT FloatingWindow : public QWidgetAdapter
     , public Draggable
@@ -48,7 +49,8 @@ public:
     explicit FloatingWindow(Frame *frame, MainWindowBase *parent = nullptr);
     ~FloatingWindow() override;
 
-    bool deserialize(const LayoutSaver::FloatingWindow &);
+    bool deserialize(const LayoutSaver::FloatingWindow &,
+                     const QHash<QString, Frame *> &reusedFrames = QHash<QString, Frame *>());
     LayoutSaver::FloatingWindow serialize() const;
 
     // Draggable:
@@ -122,6 +124,9 @@ public:
 
     QStringList affinities() const;
 
+    ///@brief returns the interned affinities(), for fast matching
+    AffinitySet affinitySet() const;
+
     /**
      * Returns the drag rect in global coordinates. This is usually the title bar rect.
      * However, when using Config::Flag_HideTitleBarWhenTabsVisible it will be the tab bar background.
@@ -32,6 +32,7 @@
 #include "Utils_p.h"
 #include "Position_p.h"
 #include "DockRegistry_p.h"
+#include "AffinitySet_p.h"
 #include "Config.h"
 #include "TitleBar_p.h"
 #include "FrameworkWidgetFactory.h"
@@ -43,6 +44,9 @@
 
 static int s_dbg_numFrames = 0;
 
+// Shared by all frames, so a higher generation means a more recent change, whichever the frame
+static quint64 s_lastGeneration = 0;
+
 using namespace KDDockWidgets;
 
 namespace KDDockWidgets {
@@ -60,6 +64,7 @@ Frame::Frame(QWidgetOrQuick *parent, FrameOptions options)
     , Layouting::Widget_qwidget(this)
     , m_titleBar(Config::self().frameworkWidgetFactory()->createTitleBar(this))
     , m_options(actualOptions(options))
+    , m_generation(++s_lastGeneration)
 {
     s_dbg_numFrames++;
     DockRegistry::self()->registerFrame(this);
@@ -245,11 +250,13 @@ void Frame::onDockWidgetCountChanged()
             Q_EMIT hasTabsVisibleChanged();
     }
 
+    markChanged();
     Q_EMIT numDockWidgetsChanged();
 }
 
 void Frame::onCurrentTabChanged(int index)
 {
+    markChanged();
     if (index != -1) {
         if (auto dock = dockWidgetAt(index)) {
             Q_EMIT currentDockWidgetChanged(dock);
@@ -259,6 +266,11 @@ void Frame::onCurrentTabChanged(int index)
     }
 }
 
+void Frame::markChanged()
+{
+    m_generation = ++s_lastGeneration;
+}
+
 void Frame::updateTitleBarVisibility()
 {
     if (m_updatingTitleBar || m_beingDeleted) {
@@ -503,6 +515,15 @@ QStringList Frame::affinities() const
     }
 }
 
+AffinitySet Frame::affinitySet() const
+{
+    if (isEmpty()) {
+        return {};
+    } else {
+        return dockWidgetAt(0)->affinitySet();
+    }
+}
+
 void Frame::setDropArea(DropArea *dt)
 {
     if (dt != m_dropArea) {
@@ -584,6 +605,18 @@ Frame *Frame::deserialize(const LayoutSaver::Frame &f)
     return frame;
 }
 
+void Frame::restoreState(const LayoutSaver::Frame &f)
+{
+    setObjectName(f.objectName);
+
+    // The dock widgets are already ours, this only marks them restored
+    for (const auto &savedDock : qAsConst(f.dockWidgets))
+        DockWidgetBase::deserialize(savedDock);
+
+    setCurrentTabIndex(f.currentTabIndex);
+    QWidget::setGeometry(f.geometry);
+}
+
 LayoutSaver::Frame Frame::serialize() const
 {
     LayoutSaver::Frame frame;
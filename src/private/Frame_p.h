@@ -45,6 +45,7 @@ class TitleBar;
 class DropArea;
 class DockWidgetBase;
 class FloatingWindow;
+class AffinitySet;
 
 /**
  * @brief A DockWidget wrapper that adds a QTabWidget and a TitleBar
@@ -71,6 +72,10 @@ public:
     static Frame *deserialize(const LayoutSaver::Frame &);
     LayoutSaver::Frame serialize() const;
 
+    ///@brief Like deserialize(), but for a frame that already has the dock widgets of @p f, in that order
+    ///Used to keep frames across a restore, see RestoreOption_Incremental.
+    void restoreState(const LayoutSaver::Frame &f);
+
     ///@brief Adds a widget into the Frame's TabWidget
     void addWidget(DockWidgetBase *, AddingOption = AddingOption_None);
     ///@overload
@@ -218,9 +223,19 @@ public:
 
     QStringList affinities() const;
 
+    ///@brief returns the interned affinities(), for fast matching
+    AffinitySet affinitySet() const;
+
     ///@brief sets the layout item that either contains this Frame in the layout or is a placeholder
     void setLayoutItem(Layouting::Item *item) override;
 
+    /**
+     * @brief Returns a value that changes whenever something serialize() saves changes
+     * The geometry isn't covered, it changes with the layout's generation. Values only grow and are
+     * shared by all frames, so the highest one tells if any frame of a layout changed.
+     */
+    quint64 generation() const { return m_generation; }
+
     /**
      * Returns the drag rect in global coordinates. This is usually the title bar rect.
      * However, when using Config::Flag_HideTitleBarWhenTabsVisible it will be the tab bar background.
@@ -273,6 +288,8 @@ private:
     friend class TabWidget;
     void onDockWidgetCountChanged();
     void onCurrentTabChanged(int index);
+    ///@brief Bumps generation(), as the dock widgets, their order or the current one changed
+    void markChanged();
     void scheduleDeleteLater();
     bool event(QEvent *) override;
     bool m_inCtor = true;
@@ -283,6 +300,7 @@ private:
     bool m_updatingTitleBar = false;
     bool m_beingDeleted = false;
     QMetaObject::Connection m_visibleWidgetCountChangedConnection;
+    quint64 m_generation;
 };
 
 }
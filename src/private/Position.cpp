@@ -159,30 +159,54 @@ void Position::deserialize(const LayoutSaver::Position &lp)
 LayoutSaver::Position Position::serialize() const
 {
     LayoutSaver::Position l;
+    l.placeholders.reserve(int(m_placeholders.size()));
 
+    // A placeholder is only looked up again if its layout changed since the last call. Generations
+    // are unique across layouts, so an item moving to another layout is noticed too.
+    QVector<SerializedPlaceholder> serialized;
+    serialized.reserve(int(m_placeholders.size()));
     for (auto &itemRef : m_placeholders) {
-        LayoutSaver::Placeholder p;
-
         Layouting::Item *item = itemRef->item;
-        MultiSplitter *layout = DockRegistry::self()->layoutForItem(item);
-        const int itemIndex = layout->items().indexOf(item);
+        Layouting::ItemContainer *root = item->root();
+        const quint64 layoutGeneration = root ? root->generation() : 0;
+        const int i = serialized.size();
+        if (layoutGeneration != 0 && i < m_serializedPlaceholders.size() && m_serializedPlaceholders.at(i).item == item
+            && m_serializedPlaceholders.at(i).layoutGeneration == layoutGeneration) {
+            serialized.push_back(m_serializedPlaceholders.at(i));
+        } else {
+            SerializedPlaceholder s { item, layoutGeneration, nullptr, {} };
+            LayoutSaver::Placeholder &p = s.placeholder;
+
+            MultiSplitter *layout = DockRegistry::self()->layoutForItem(item);
+            const int itemIndex = layout->indexOfItem(item);
 
-        auto fw = layout->floatingWindow();
-        auto mainWindow = layout->mainWindow();
-        Q_ASSERT(mainWindow || fw);
-        p.isFloatingWindow = fw;
+            auto fw = layout->floatingWindow();
+            auto mainWindow = layout->mainWindow();
+            Q_ASSERT(mainWindow || fw);
+            p.isFloatingWindow = fw;
+            s.floatingWindow = fw;
+
+            if (!p.isFloatingWindow) {
+                p.mainWindowUniqueName = mainWindow->uniqueName();
+                Q_ASSERT(!p.mainWindowUniqueName.isEmpty());
+            }
 
+            p.itemIndex = itemIndex;
+            serialized.push_back(s);
+        }
+
+        LayoutSaver::Placeholder p = serialized.last().placeholder;
         if (p.isFloatingWindow) {
-            p.indexOfFloatingWindow = fw->beingDeleted() ? -1 : DockRegistry::self()->nestedwindows().indexOf(fw); // TODO: Remove once we stop using deleteLater with FloatingWindow. delete would be better
-        } else {
-            p.mainWindowUniqueName = mainWindow->uniqueName();
-            Q_ASSERT(!p.mainWindowUniqueName.isEmpty());
+            // Not cached, it changes when other floating windows come and go
+            FloatingWindow *fw = serialized.last().floatingWindow;
+            p.indexOfFloatingWindow = !fw || fw->beingDeleted() ? -1 : DockRegistry::self()->nestedwindows().indexOf(fw); // TODO: Remove once we stop using deleteLater with FloatingWindow. delete would be better
         }
 
-        p.itemIndex = itemIndex;
         l.placeholders.push_back(p);
     }
 
+    m_serializedPlaceholders = serialized;
+
     l.tabIndex = m_tabIndex;
     l.wasFloating = m_wasFloating;
 
@@ -61,6 +61,7 @@ private:
 
 
 class DockWidgetBase;
+class FloatingWindow;
 class Frame;
 
 /**
@@ -127,6 +128,16 @@ private:
     // The last places where this dock widget was (or is), so it can be restored when setFloating(false) or show() is called.
     std::vector<std::unique_ptr<ItemRef>> m_placeholders;
     bool m_clearing = false; // to prevent re-entrancy
+
+    ///@brief What serialize() saved for each placeholder, valid while the placeholder's layout
+    ///keeps the same generation
+    struct SerializedPlaceholder {
+        const Layouting::Item *item;
+        quint64 layoutGeneration;
+        QPointer<FloatingWindow> floatingWindow;
+        LayoutSaver::Placeholder placeholder;
+    };
+    mutable QVector<SerializedPlaceholder> m_serializedPlaceholders;
 };
 
 struct LastPositions
@@ -254,3 +254,9 @@ void TabWidget::onTabRemoved()
 {
     m_frame->onDockWidgetCountChanged();
 }
+
+void TabWidget::onTabMoved()
+{
+    // The order of the dock widgets is saved
+    m_frame->markChanged();
+}
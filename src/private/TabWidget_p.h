@@ -182,6 +182,7 @@ public:
 protected:
     void onTabInserted();
     void onTabRemoved();
+    void onTabMoved();
 
 private:
     Frame *const m_frame;
@@ -24,12 +24,16 @@
 #include "Widget.h"
 
 #include <QEvent>
+#include <QJsonArray>
 #include <QDebug>
 #include <QScopedValueRollback>
+#include <QPointer>
 #include <QTimer>
 #include <QGuiApplication>
 #include <QScreen>
 
+#include <algorithm>
+
 #ifdef Q_OS_WIN
 # pragma warning(push)
 # pragma warning(disable:4138)
@@ -44,6 +48,59 @@ int Layouting::Item::separatorThickness = 5;
 const QSize Layouting::Item::hardcodedMinimumSize = QSize(KDDOCKWIDGETS_MIN_WIDTH, KDDOCKWIDGETS_MIN_HEIGHT);
 const QSize Layouting::Item::hardcodedMaximumSize = QSize(KDDOCKWIDGETS_MAX_WIDTH, KDDOCKWIDGETS_MAX_HEIGHT);
 
+// Shared by all layouts, so a generation value identifies a single state of a single layout
+static quint64 s_lastGeneration = 0;
+
+///@brief The keys used by toJsonObject() and fillFromJsonObject()
+namespace Keys {
+static const QLatin1String children("children");
+static const QLatin1String geometry("geometry");
+static const QLatin1String guestId("guestId");
+static const QLatin1String height("height");
+static const QLatin1String isContainer("isContainer");
+static const QLatin1String isVisible("isVisible");
+static const QLatin1String maxSize("maxSize");
+static const QLatin1String minSize("minSize");
+static const QLatin1String objectName("objectName");
+static const QLatin1String orientation("orientation");
+static const QLatin1String sizingInfo("sizingInfo");
+static const QLatin1String width("width");
+static const QLatin1String x("x");
+static const QLatin1String y("y");
+}
+
+static QJsonObject sizeToJson(QSize sz)
+{
+    QJsonObject object;
+    object.insert(Keys::width, sz.width());
+    object.insert(Keys::height, sz.height());
+    return object;
+}
+
+static QJsonObject rectToJson(QRect rect)
+{
+    QJsonObject object;
+    object.insert(Keys::x, rect.x());
+    object.insert(Keys::y, rect.y());
+    object.insert(Keys::width, rect.width());
+    object.insert(Keys::height, rect.height());
+    return object;
+}
+
+static QSize jsonToSize(const QJsonObject &object)
+{
+    return { object.value(Keys::width).toInt(),
+             object.value(Keys::height).toInt() };
+}
+
+static QRect jsonToRect(const QJsonObject &object)
+{
+    return QRect(object.value(Keys::x).toInt(),
+                 object.value(Keys::y).toInt(),
+                 object.value(Keys::width).toInt(),
+                 object.value(Keys::height).toInt());
+}
+
 inline bool locationIsVertical(Item::Location loc)
 {
     return loc == Item::Location_OnTop || loc == Item::Location_OnBottom;
@@ -86,6 +143,81 @@ inline QRect adjustedRect(QRect r, Qt::Orientation o, int p1, int p2)
     return r;
 }
 
+///@brief How waterFill() hands out what's left when it can't be split evenly anymore
+enum class RemainderMode {
+    Greedy, ///< Each item, in index order, takes as much as it can
+    OneEach ///< Each item, in index order, takes 1
+};
+
+/**
+ * Distributes @p amount among items with the given @p capacities, giving the same result as the
+ * round-robin loops in calculateSqueezes() and honourMaxSizes(): In each round, every item with
+ * capacity left takes amount / numItems, bounded by its capacity. Once that's 0, the remainder is
+ * given according to @p remainderMode.
+ *
+ * Instead of simulating each round, the items are sorted by capacity and we only iterate over the
+ * levels at which an item gets exhausted. O(n log n).
+ *
+ * Returns an empty vector if the capacities don't add up to @p amount.
+ */
+static QVector<int> waterFill(const QVector<int> &capacities, int amount, RemainderMode remainderMode)
+{
+    const int count = capacities.size();
+    QVector<int> donors;
+    donors.reserve(count);
+    qint64 totalCapacity = 0;
+    for (int i = 0; i < count; ++i) {
+        if (capacities.at(i) > 0) {
+            donors.push_back(i);
+            totalCapacity += capacities.at(i);
+        }
+    }
+
+    if (totalCapacity < amount)
+        return {};
+
+    std::sort(donors.begin(), donors.end(), [&capacities] (int a, int b) {
+        return capacities.at(a) < capacities.at(b);
+    });
+
+    // Every item gives min(capacity, level). Raise the level while it can be split evenly.
+    int level = 0;
+    int numExhausted = 0;
+    int missing = amount;
+    while (missing > 0) {
+        const int numDonors = donors.size() - numExhausted;
+        const int toTake = missing / numDonors;
+        if (toTake == 0)
+            break;
+
+        level += toTake;
+        missing -= numDonors * toTake;
+
+        // Donors with capacity below the new level couldn't give everything
+        while (numExhausted < donors.size() && capacities.at(donors.at(numExhausted)) <= level) {
+            missing += level - capacities.at(donors.at(numExhausted));
+            numExhausted++;
+        }
+    }
+
+    QVector<int> result(count, 0);
+    for (int i = 0; i < count; ++i)
+        result[i] = qBound(0, capacities.at(i), level);
+
+    // Now there's less missing than donors, distribute it in index order
+    for (int i = 0; i < count && missing > 0; ++i) {
+        const int available = capacities.at(i) - result.at(i);
+        if (available > 0) {
+            const int took = remainderMode == RemainderMode::Greedy ? qMin(missing, available)
+                                                                    : 1;
+            result[i] += took;
+            missing -= took;
+        }
+    }
+
+    return result;
+}
+
 namespace Layouting {
 struct LengthOnSide
 {
@@ -177,9 +309,12 @@ void Item::setGuestWidget(Widget *guest)
     if (oldWidget) {
         oldWidget->removeEventFilter(this);
         disconnect(oldWidget, nullptr, this, nullptr);
+        if (auto r = root())
+            r->unregisterGuest(oldWidget, this);
     }
 
     m_guest = guest;
+    markLayoutChanged();
 
     if (m_guest) {
         m_guest->setLayoutItem(this);
@@ -192,6 +327,9 @@ void Item::setGuestWidget(Widget *guest)
         connect(newWidget, &QObject::destroyed, this, &Item::onWidgetDestroyed);
         connect(newWidget, SIGNAL(layoutInvalidated()), this, SLOT(onWidgetLayoutRequested()));
 
+        if (auto r = root())
+            r->registerGuests(this);
+
         if (m_sizingInfo.geometry.isEmpty()) {
             // Use the widgets geometry, but ensure it's at least hardcodedMinimumSize
             QRect widgetGeo = m_guest->geometry();
@@ -206,33 +344,43 @@ void Item::setGuestWidget(Widget *guest)
 }
 
 void Item::updateWidgetGeometries()
+{
+    if (auto r = root()) {
+        if (r->isInTransaction()) // Will be done once, in commitTransaction()
+            return;
+    }
+
+    updateWidgetGeometries_recursive();
+}
+
+void Item::updateWidgetGeometries_recursive()
 {
     if (m_guest) {
         m_guest->setGeometry(mapToRoot(rect()));
     }
 }
 
-QVariantMap Item::toVariantMap() const
+QJsonObject Item::toJsonObject() const
 {
-    QVariantMap result;
+    QJsonObject result;
 
-    result[QStringLiteral("sizingInfo")] = m_sizingInfo.toVariantMap();
-    result[QStringLiteral("isVisible")] = m_isVisible;
-    result[QStringLiteral("isContainer")] = isContainer();
-    result[QStringLiteral("objectName")] = objectName();
+    result.insert(Keys::sizingInfo, m_sizingInfo.toJsonObject());
+    result.insert(Keys::isVisible, m_isVisible);
+    result.insert(Keys::isContainer, isContainer());
+    result.insert(Keys::objectName, objectName());
     if (m_guest)
-        result[QStringLiteral("guestId")] = m_guest->id(); // just for coorelation purposes when restoring
+        result.insert(Keys::guestId, m_guest->id()); // just for coorelation purposes when restoring
 
     return result;
 }
 
-void Item::fillFromVariantMap(const QVariantMap &map, const QHash<QString, Widget *> &widgets)
+void Item::fillFromJsonObject(const QJsonObject &object, const QHash<QString, Widget *> &widgets)
 {
-    m_sizingInfo.fromVariantMap(map[QStringLiteral("sizingInfo")].toMap());
-    m_isVisible = map[QStringLiteral("isVisible")].toBool();
-    setObjectName(map[QStringLiteral("objectName")].toString());
+    m_sizingInfo.fromJsonObject(object.value(Keys::sizingInfo).toObject());
+    m_isVisible = object.value(Keys::isVisible).toBool();
+    setObjectName(object.value(Keys::objectName).toString());
 
-    const QString guestId = map.value(QStringLiteral("guestId")).toString();
+    const QString guestId = object.value(Keys::guestId).toString();
     if (!guestId.isEmpty()) {
         if (Widget *guest = widgets.value(guestId)) {
             setGuestWidget(guest);
@@ -243,11 +391,11 @@ void Item::fillFromVariantMap(const QVariantMap &map, const QHash<QString, Widge
     }
 }
 
-Item *Item::createFromVariantMap(Widget *hostWidget, ItemContainer *parent,
-                                 const QVariantMap &map, const QHash<QString, Widget *> &widgets)
+Item *Item::createFromJsonObject(Widget *hostWidget, ItemContainer *parent,
+                                 const QJsonObject &object, const QHash<QString, Widget *> &widgets)
 {
-    auto item = new Item(hostWidget, parent);
-    item->fillFromVariantMap(map, widgets);
+    auto item = new (parent ? parent->arena() : nullptr) Item(hostWidget, parent);
+    item->fillFromJsonObject(object, widgets);
     return item;
 }
 
@@ -356,6 +504,8 @@ bool Item::isBeingInserted() const
 void Item::setBeingInserted(bool is)
 {
     m_sizingInfo.isBeingInserted = is;
+    if (m_parent)
+        m_parent->invalidateCachedSizes();
 
     // Trickle up the hierarchy too, as the parent might be hidden due to not having visible children
     if (auto parent = parentContainer()) {
@@ -392,6 +542,11 @@ void Item::setParentContainer(ItemContainer *parent)
     connectParent(parent); // Reused by the ctor too
 
     QObject::setParent(parent);
+
+    if (parent) {
+        // Our guests, and the ones of our children, are now reachable from a different root
+        parent->root()->registerGuests(this);
+    }
 }
 
 void Item::connectParent(ItemContainer *parent)
@@ -426,6 +581,7 @@ void Item::setMinSize(QSize sz)
 {
     if (sz != m_sizingInfo.minSize) {
         m_sizingInfo.minSize = sz;
+        markLayoutChanged();
         Q_EMIT minSizeChanged(this);
         setSize_recursive(size().expandedTo(sz));
     }
@@ -435,6 +591,9 @@ void Item::setMaxSizeHint(QSize sz)
 {
     if (sz != m_sizingInfo.maxSizeHint) {
         m_sizingInfo.maxSizeHint = sz;
+        markLayoutChanged();
+        if (m_parent)
+            m_parent->invalidateCachedSizes();
         Q_EMIT maxSizeChanged(this);
     }
 }
@@ -608,11 +767,12 @@ void Item::setIsVisible(bool is)
 {
     if (is != m_isVisible) {
         m_isVisible = is;
+        markLayoutChanged();
         Q_EMIT visibleChanged(this, is);
     }
 
     if (is && m_guest) {
-        m_guest->setGeometry(mapToRoot(rect()));
+        updateWidgetGeometries();
         m_guest->setVisible(true); // TODO: Only set visible when apply*() ?
     }
 
@@ -652,7 +812,8 @@ bool Item::checkSanity()
             return false;
         }
 
-        if (m_guest->geometry() != mapToRoot(rect())) {
+        // Guest geometries are only updated when the transaction is committed
+        if (!root()->isInTransaction() && m_guest->geometry() != mapToRoot(rect())) {
             root()->dumpLayout();
             auto d = qWarning();
             d << Q_FUNC_INFO << "Guest widget doesn't have correct geometry. has"
@@ -682,15 +843,17 @@ void Item::setGeometry(QRect rect)
 
     if (rect != m_geometry) {
         const QRect oldGeo = m_geometry;
+        ItemContainer *const r = root(); // Only walk up once, this is a hot path
 
         m_geometry = rect;
+        markLayoutChanged(r);
 
         if (rect.isEmpty()) {
             // Just a sanity check...
             ItemContainer *c = asContainer();
             if (c) {
                 if (c->hasVisibleChildren()) {
-                    if (auto r = root()) r->dumpLayout();
+                    if (r) r->dumpLayout();
                     Q_ASSERT(false);
                 }
             } else {
@@ -700,28 +863,38 @@ void Item::setGeometry(QRect rect)
 
         const QSize minSz = minSize();
         if (rect.width() < minSz.width() || rect.height() < minSz.height()) {
-            if (auto r = root()) r->dumpLayout();
+            if (r) r->dumpLayout();
             qWarning() << Q_FUNC_INFO << this << "Constraints not honoured."
                        << "sz=" << rect.size() << "; min=" << minSz
                        << ": parent=" << parentContainer();
 
         }
 
-        Q_EMIT geometryChanged();
-
-        if (oldGeo.x() != x())
-            Q_EMIT xChanged();
-        if (oldGeo.y() != y())
-            Q_EMIT yChanged();
-        if (oldGeo.width() != width())
-            Q_EMIT widthChanged();
-        if (oldGeo.height() != height())
-            Q_EMIT heightChanged();
+        if (r && r->d->m_transactionDepth > 0) {
+            // Signals and widget geometries are coalesced and done in commitTransaction()
+            r->deferGeometryChange(this, oldGeo);
+            return;
+        }
 
-        updateWidgetGeometries();
+        emitGeometryChanged(oldGeo);
+        updateWidgetGeometries_recursive();
     }
 }
 
+void Item::emitGeometryChanged(QRect oldGeo)
+{
+    Q_EMIT geometryChanged();
+
+    if (oldGeo.x() != x())
+        Q_EMIT xChanged();
+    if (oldGeo.y() != y())
+        Q_EMIT yChanged();
+    if (oldGeo.width() != width())
+        Q_EMIT widthChanged();
+    if (oldGeo.height() != height())
+        Q_EMIT heightChanged();
+}
+
 void Item::dumpLayout(int level)
 {
     QString indent;
@@ -749,6 +922,171 @@ void Item::dumpLayout(int level)
     dbg << this << "; guest=" << guestAsQObject();
 }
 
+#if defined(__SANITIZE_ADDRESS__)
+# define KDMULTISPLITTER_NO_ITEM_ARENA
+#elif defined(__has_feature)
+# if __has_feature(address_sanitizer)
+#  define KDMULTISPLITTER_NO_ITEM_ARENA
+# endif
+#endif
+
+///@brief Precedes each Item in memory. Aligned like operator new would, so the Item that follows is too.
+struct alignas(std::max_align_t) ItemArena::Block
+{
+    ItemArena *arena; // null for plain allocations
+    std::size_t blockSize; // including this header
+};
+
+static const std::size_t s_arenaChunkSize = 16 * 1024;
+
+std::size_t ItemArena::blockSizeFor(std::size_t itemSize)
+{
+    const std::size_t alignment = alignof(std::max_align_t);
+    return sizeof(Block) + (itemSize + alignment - 1) / alignment * alignment;
+}
+
+ItemArena::Block *&ItemArena::nextFreeBlock(Block *block)
+{
+    return *reinterpret_cast<Block **>(block + 1);
+}
+
+void *ItemArena::allocate(ItemArena *arena, std::size_t size)
+{
+    const std::size_t blockSize = blockSizeFor(size);
+    if (!isEnabled() || blockSize > s_arenaChunkSize)
+        arena = nullptr;
+
+    Block *block = nullptr;
+    if (arena) {
+        for (FreeList &list : arena->m_freeLists) {
+            if (list.size == blockSize && list.head) {
+                block = list.head;
+                list.head = nextFreeBlock(block);
+                break;
+            }
+        }
+
+        if (!block) {
+            if (arena->m_chunks.isEmpty() || arena->m_usedInLastChunk + blockSize > s_arenaChunkSize) {
+                arena->m_chunks.push_back(static_cast<char*>(::operator new(s_arenaChunkSize)));
+                arena->m_usedInLastChunk = 0;
+            }
+
+            block = reinterpret_cast<Block*>(arena->m_chunks.constLast() + arena->m_usedInLastChunk);
+            arena->m_usedInLastChunk += blockSize;
+        }
+
+        arena->m_numLiveItems++;
+    } else {
+        block = static_cast<Block*>(::operator new(blockSize));
+    }
+
+    block->arena = arena;
+    block->blockSize = blockSize;
+    return block + 1;
+}
+
+void ItemArena::deallocate(void *ptr)
+{
+    if (!ptr)
+        return;
+
+    Block *block = static_cast<Block*>(ptr) - 1;
+    if (block->arena) {
+        block->arena->recycle(block);
+    } else {
+        ::operator delete(block);
+    }
+}
+
+bool ItemArena::isEnabled()
+{
+#ifdef KDMULTISPLITTER_NO_ITEM_ARENA
+    return false;
+#else
+    return true;
+#endif
+}
+
+int ItemArena::numLiveItems() const
+{
+    return m_numLiveItems;
+}
+
+int ItemArena::numChunks() const
+{
+    return m_chunks.size();
+}
+
+ItemArena::~ItemArena()
+{
+    for (char *chunk : qAsConst(m_chunks))
+        ::operator delete(chunk);
+}
+
+void ItemArena::releaseRoot()
+{
+    m_hasRoot = false;
+    if (m_numLiveItems == 0)
+        delete this;
+}
+
+void ItemArena::releaseUnused()
+{
+    if (m_numLiveItems > 0 || m_chunks.isEmpty())
+        return;
+
+    // Keep one chunk, as a cleared layout is usually filled again
+    for (int i = 1; i < m_chunks.size(); ++i)
+        ::operator delete(m_chunks.at(i));
+
+    m_chunks.resize(1);
+    m_usedInLastChunk = 0;
+    m_freeLists.clear();
+}
+
+void ItemArena::recycle(Block *block)
+{
+    FreeList *list = nullptr;
+    for (FreeList &candidate : m_freeLists) {
+        if (candidate.size == block->blockSize) {
+            list = &candidate;
+            break;
+        }
+    }
+
+    if (!list) {
+        m_freeLists.push_back({ block->blockSize, nullptr });
+        list = &m_freeLists.last();
+    }
+
+    nextFreeBlock(block) = list->head;
+    list->head = block;
+
+    if (--m_numLiveItems == 0 && !m_hasRoot)
+        delete this;
+}
+
+void *Item::operator new(std::size_t size)
+{
+    return ItemArena::allocate(nullptr, size);
+}
+
+void *Item::operator new(std::size_t size, ItemArena *arena)
+{
+    return ItemArena::allocate(arena, size);
+}
+
+void Item::operator delete(void *ptr)
+{
+    ItemArena::deallocate(ptr);
+}
+
+void Item::operator delete(void *ptr, ItemArena *)
+{
+    ItemArena::deallocate(ptr);
+}
+
 Item::Item(Widget *hostWidget, ItemContainer *parent)
     : QObject(parent)
     , m_isContainer(false)
@@ -802,6 +1140,7 @@ void Item::updateObjectName()
     if (isContainer())
         return;
 
+    const QString oldName = objectName();
     if (auto w = guestAsQObject()) {
         setObjectName(w->objectName().isEmpty() ? QStringLiteral("widget") : w->objectName());
     } else if (!isVisible()) {
@@ -811,11 +1150,18 @@ void Item::updateObjectName()
     } else {
         setObjectName(QStringLiteral("empty"));
     }
+
+    if (objectName() != oldName)
+        markLayoutChanged(); // It's saved by toJsonObject()
 }
 
-void Item::onWidgetDestroyed()
+void Item::onWidgetDestroyed(QObject *guest)
 {
     m_guest = nullptr;
+    markLayoutChanged();
+
+    if (auto r = root())
+        r->unregisterGuest(guest, this);
 
     if (m_refCount) {
         turnIntoPlaceholder();
@@ -824,6 +1170,18 @@ void Item::onWidgetDestroyed()
     }
 }
 
+void Item::copyStateFrom(const Item *other)
+{
+    // Copies only what the layouting algorithms need, which is the same as what
+    // toJsonObject()/fillFromJsonObject() would carry over, minus the guest and the object name.
+    m_sizingInfo.geometry = other->m_sizingInfo.geometry;
+    m_sizingInfo.minSize = other->m_sizingInfo.minSize;
+    m_sizingInfo.maxSizeHint = other->m_sizingInfo.maxSizeHint;
+    m_sizingInfo.percentageWithinParent = 0.0;
+    m_sizingInfo.isBeingInserted = false;
+    m_isVisible = other->m_isVisible;
+}
+
 void Item::onWidgetLayoutRequested()
 {
     if (Widget *w = guestWidget()) {
@@ -865,6 +1223,9 @@ struct ItemContainer::Private
     bool isOverflowing() const;
     void relayoutIfNeeded();
     const Item *itemFromPath(const QVector<int> &path) const;
+    void copyFrom(const ItemContainer *other);
+    static bool canRestoreGeometries(const Item *item, const QJsonObject &object);
+    static void restoreGeometries(Item *item, const QJsonObject &object);
     void resizeChildren(QSize oldSize, QSize newSize, SizingInfo::List &sizes, ChildrenResizeStrategy);
     void honourMaxSizes(SizingInfo::List &sizes);
     void scheduleCheckSanity() const;
@@ -874,23 +1235,50 @@ struct ItemContainer::Private
     /// Returns the positions that each separator should have (x position if Qt::Horizontal, y otherwise)
     QVector<int> requiredSeparatorPositions() const;
     void updateSeparators();
-    void deleteSeparators();
-    Separator* separatorAt(int p) const;
+    ///@brief Returns our separators to the pool, see Config::releaseSeparator()
+    void releaseSeparators();
     QVector<double> childPercentages() const;
     bool isDummy() const;
-    void deleteSeparators_recursive();
+    void releaseSeparators_recursive();
     void updateSeparators_recursive();
+    QSize calculateMinSize() const;
+    QSize calculateMaxSizeHint() const;
+    /// Returns the children itemAt() considers, which are the visible ones, in layout order
+    const Item::List &hitTestChildren() const;
+
+    struct DeferredGeometryChange {
+        QPointer<Item> item;
+        QRect oldGeometry;
+    };
 
     mutable bool m_checkSanityScheduled = false;
+    mutable bool m_minSizeDirty = true;
+    mutable bool m_maxSizeHintDirty = true;
+    mutable QSize m_cachedMinSize;
+    mutable QSize m_cachedMaxSizeHint;
+    mutable bool m_hitTestChildrenDirty = true;
+    mutable Item::List m_hitTestChildren;
     QVector<Layouting::Separator*> m_separators;
     bool m_convertingItemToContainer = false;
     bool m_blockUpdatePercentages = false;
     bool m_isDeserializing = false;
+    bool m_isAboutToClear = false;
+    int m_transactionDepth = 0;
+    // Only used by the root container. Our Items are allocated from it, see ItemArena
+    ItemArena *m_arena = nullptr;
+    // Only used by the root container. Maps guest widgets to their item, for O(1) lookups.
+    QHash<const QObject*, QPointer<Item>> m_itemsByGuest;
+    // Only used by the root container. See ItemContainer::generation()
+    quint64 m_generation = ++s_lastGeneration;
+    QVector<DeferredGeometryChange> m_deferredGeometryChanges;
+    QHash<const Item*, int> m_deferredGeometryChangeIndexes;
     Qt::Orientation m_orientation = Qt::Vertical;
     Item::List m_children;
     ItemContainer *const q;
 };
 
+bool ItemContainer::s_useRoundRobinDistribution = false;
+
 ItemContainer::ItemContainer(Widget *hostWidget, ItemContainer *parent)
     : Item(true, hostWidget, parent)
     , d(new Private(this))
@@ -914,10 +1302,13 @@ ItemContainer::ItemContainer(Widget *hostWidget)
     : Item(true, hostWidget, /*parentContainer=*/ nullptr)
     , d(new Private(this))
 {
+    d->m_arena = new ItemArena();
 }
 
 ItemContainer::~ItemContainer()
 {
+    if (d->m_arena)
+        d->m_arena->releaseRoot(); // Our children are only deleted after us, by ~QObject()
     delete d;
 }
 
@@ -938,6 +1329,30 @@ bool ItemContainer::checkSanity()
         return false;
     }
 
+    if (!d->m_minSizeDirty && d->m_cachedMinSize != d->calculateMinSize()) {
+        qWarning() << Q_FUNC_INFO << "Stale cached min-size" << d->m_cachedMinSize
+                   << "; expected=" << d->calculateMinSize() << this;
+        return false;
+    }
+
+    if (!d->m_maxSizeHintDirty && d->m_cachedMaxSizeHint != d->calculateMaxSizeHint()) {
+        qWarning() << Q_FUNC_INFO << "Stale cached max-size" << d->m_cachedMaxSizeHint
+                   << "; expected=" << d->calculateMaxSizeHint() << this;
+        return false;
+    }
+
+    if (isRoot()) {
+        const Item::List items = items_recursive();
+        for (Item *item : items) {
+            QObject *guest = item->guestAsQObject();
+            if (guest && itemForObject(guest) != item) {
+                qWarning() << Q_FUNC_INFO << "Guest index out of sync for" << guest
+                           << "; item=" << item << "; indexed=" << itemForObject(guest);
+                return false;
+            }
+        }
+    }
+
     if (d->m_orientation != Qt::Vertical && d->m_orientation != Qt::Horizontal) {
         qWarning() << Q_FUNC_INFO << "Invalid orientation" << d->m_orientation << this;
         return false;
@@ -1025,6 +1440,10 @@ bool ItemContainer::checkSanity()
         }
     }
 
+    // Separators are only updated when the transaction is committed. The item tree was checked above.
+    if (isInTransaction())
+        return true;
+
     const int numVisibleChildren = visibleChildren.size();
     if (d->m_separators.size() != qMax(0, numVisibleChildren - 1)) {
         root()->dumpLayout();
@@ -1161,14 +1580,17 @@ void ItemContainer::removeItem(Item *item, bool hardRemove)
         return;
     }
 
-    Item *side1Item = visibleNeighbourFor(item, Side1);
-    Item *side2Item = visibleNeighbourFor(item, Side2);
+    // If everything is going away there's no point in having the neighbours occupy the space
+    const bool aboutToClear = isAboutToClear();
+    Item *side1Item = aboutToClear ? nullptr : visibleNeighbourFor(item, Side1);
+    Item *side2Item = aboutToClear ? nullptr : visibleNeighbourFor(item, Side2);
 
     const bool isContainer = item->isContainer();
     const bool wasVisible = !isContainer && item->isVisible();
 
     if (hardRemove) {
         d->m_children.removeOne(item);
+        invalidateCachedSizes();
         delete item;
         if (!isContainer)
             Q_EMIT root()->numItemsChanged();
@@ -1195,6 +1617,8 @@ void ItemContainer::removeItem(Item *item, bool hardRemove)
             p->removeItem(this, /*hardDelete=*/ false);
             setGeometry(QRect());
         }
+    } else if (aboutToClear) {
+        Q_EMIT itemsChanged();
     } else {
         // Neighbours will occupy the space of the deleted item
         growNeighbours(side1Item, side2Item);
@@ -1224,12 +1648,13 @@ ItemContainer *ItemContainer::convertChildToContainer(Item *leaf)
 
     const int index = d->m_children.indexOf(leaf);
     Q_ASSERT(index != -1);
-    auto container = new ItemContainer(hostWidget(), this);
+    auto container = new (arena()) ItemContainer(hostWidget(), this);
     container->setParentContainer(nullptr);
     container->setParentContainer(this);
 
     insertItem(container, index, DefaultSizeMode::None);
     d->m_children.removeOne(leaf);
+    invalidateCachedSizes();
     container->setGeometry(leaf->geometry());
     container->insertItem(leaf, Location_OnTop, DefaultSizeMode::None);
     Q_EMIT itemsChanged();
@@ -1256,6 +1681,7 @@ void ItemContainer::insertItem(Item *item, Location loc, DefaultSizeMode default
         if (d->m_children.size() == 1) {
             // 2 items is the minimum to know which orientation we're layedout
             d->m_orientation = locOrientation;
+            invalidateCachedSizes();
         }
 
         const int index = locationIsSide1(loc) ? 0 : d->m_children.size();
@@ -1263,10 +1689,11 @@ void ItemContainer::insertItem(Item *item, Location loc, DefaultSizeMode default
     } else {
         // Inserting directly in a container ? Only if it's root.
         Q_ASSERT(isRoot());
-        auto container = new ItemContainer(hostWidget(), this);
+        auto container = new (arena()) ItemContainer(hostWidget(), this);
         container->setGeometry(rect());
         container->setChildren(d->m_children, d->m_orientation);
         d->m_children.clear();
+        invalidateCachedSizes();
         setOrientation(oppositeOrientation(d->m_orientation));
         insertItem(container, 0, DefaultSizeMode::None);
 
@@ -1283,6 +1710,8 @@ void ItemContainer::insertItem(Item *item, Location loc, DefaultSizeMode default
 
 void ItemContainer::onChildMinSizeChanged(Item *child)
 {
+    invalidateCachedSizes();
+
     if (d->m_convertingItemToContainer || d->m_isDeserializing || !child->isVisible()) {
         // Don't bother our parents, we're converting
         return;
@@ -1325,6 +1754,8 @@ void ItemContainer::updateSizeConstraints()
 
 void ItemContainer::onChildVisibleChanged(Item *, bool visible)
 {
+    invalidateCachedSizes();
+
     if (d->m_isDeserializing)
         return;
 
@@ -1378,16 +1809,14 @@ QRect ItemContainer::suggestedDropRect(const Item *item, const Item *relativeTo,
     if (windowNeedsGrowing)
         return suggestedDropRectFallback(item, relativeTo, loc);
 
-    const QVariantMap rootSerialized = root()->toVariantMap();
     ItemContainer rootCopy(nullptr);
-    rootCopy.fillFromVariantMap(rootSerialized, {});
+    rootCopy.d->copyFrom(root());
 
     if (relativeTo)
         relativeTo = rootCopy.d->itemFromPath(relativeTo->pathFromRoot());
 
-    const QVariantMap itemSerialized = item->toVariantMap();
-    auto itemCopy = new Item(nullptr);
-    itemCopy->fillFromVariantMap(itemSerialized, {});
+    auto itemCopy = new (rootCopy.arena()) Item(nullptr);
+    itemCopy->copyStateFrom(item);
 
     if (relativeTo) {
         auto r = const_cast<Item*>(relativeTo);
@@ -1550,38 +1979,141 @@ void ItemContainer::clear()
         delete item;
     }
     d->m_children.clear();
-    d->deleteSeparators();
+    invalidateCachedSizes();
+    d->releaseSeparators();
+
+    if (isRoot())
+        d->m_isAboutToClear = false;
+
+    if (d->m_arena)
+        d->m_arena->releaseUnused();
 }
 
-Item* ItemContainer::itemForObject(const QObject *o) const
+void ItemContainer::beginTransaction()
 {
-    for (Item *item : d->m_children) {
-        if (item->isContainer()) {
-            if (Item *result = item->asContainer()->itemForObject(o))
-                return result;
-        } else if (auto guest = item->guestWidget()) {
-            if (guest && guest->asQObject() == o)
-                return item;
+    Q_ASSERT(isRoot());
+    d->m_transactionDepth++;
+}
+
+void ItemContainer::commitTransaction()
+{
+    if (d->m_transactionDepth <= 0) {
+        qWarning() << Q_FUNC_INFO << "No transaction in progress" << this;
+        return;
+    }
+
+    if (--d->m_transactionDepth > 0)
+        return;
+
+    const QVector<Private::DeferredGeometryChange> changes = d->m_deferredGeometryChanges;
+    d->m_deferredGeometryChanges.clear();
+    d->m_deferredGeometryChangeIndexes.clear();
+
+    if (isInTransaction()) {
+        // We were reparented into a container which is itself in a transaction. It will do the work.
+        for (const Private::DeferredGeometryChange &change : changes) {
+            if (change.item)
+                root()->deferGeometryChange(change.item, change.oldGeometry);
         }
+        return;
     }
 
-    return nullptr;
+    if (hostWidget()) {
+        d->updateSeparators_recursive();
+        updateWidgetGeometries();
+    }
+
+    for (const Private::DeferredGeometryChange &change : changes) {
+        Item *item = change.item;
+        if (item && item->geometry() != change.oldGeometry)
+            item->emitGeometryChanged(change.oldGeometry);
+    }
 }
 
-Item *ItemContainer::itemForWidget(const Widget *w) const
+bool ItemContainer::isInTransaction() const
 {
-    for (Item *item : qAsConst(d->m_children)) {
-        if (item->isContainer()) {
-            if (Item *result = item->asContainer()->itemForWidget(w))
-                return result;
-        } else if (item->guestWidget() == w) {
+    return root()->d->m_transactionDepth > 0;
+}
+
+void ItemContainer::aboutToClear()
+{
+    Q_ASSERT(isRoot());
+    d->m_isAboutToClear = true;
+}
+
+bool ItemContainer::isAboutToClear() const
+{
+    return root()->d->m_isAboutToClear;
+}
+
+LayoutTransaction::LayoutTransaction(ItemContainer *root)
+    : m_root(root)
+{
+    if (m_root)
+        m_root->beginTransaction();
+}
+
+LayoutTransaction::~LayoutTransaction()
+{
+    if (m_root)
+        m_root->commitTransaction();
+}
+
+void ItemContainer::deferGeometryChange(Item *item, QRect oldGeometry)
+{
+    // Only the first old geometry matters, so we emit a single notification per item
+    auto it = d->m_deferredGeometryChangeIndexes.constFind(item);
+    if (it != d->m_deferredGeometryChangeIndexes.cend() && d->m_deferredGeometryChanges.at(*it).item)
+        return;
+
+    d->m_deferredGeometryChangeIndexes.insert(item, d->m_deferredGeometryChanges.size());
+    d->m_deferredGeometryChanges.push_back({ item, oldGeometry });
+}
+
+Item* ItemContainer::itemForObject(const QObject *o) const
+{
+    if (!o)
+        return nullptr;
+
+    Item *item = root()->d->m_itemsByGuest.value(o);
+    if (!item || item->guestAsQObject() != o) {
+        // The index isn't pruned when items are deleted or move to another root, so verify
+        return nullptr;
+    }
+
+    for (const ItemContainer *c = item->parentContainer(); c; c = c->parentContainer()) {
+        if (c == this)
             return item;
-        }
     }
 
     return nullptr;
 }
 
+Item *ItemContainer::itemForWidget(const Widget *w) const
+{
+    return w ? itemForObject(w->asQObject())
+             : nullptr;
+}
+
+void ItemContainer::registerGuests(Item *item)
+{
+    if (ItemContainer *c = item->asContainer()) {
+        // Only root keeps an index. Drop the one from when it was root, if any.
+        c->d->m_itemsByGuest.clear();
+        for (Item *child : qAsConst(c->d->m_children))
+            registerGuests(child);
+    } else if (QObject *guest = item->guestAsQObject()) {
+        d->m_itemsByGuest.insert(guest, item);
+    }
+}
+
+void ItemContainer::unregisterGuest(const QObject *guest, const Item *item)
+{
+    auto it = d->m_itemsByGuest.find(guest);
+    if (it != d->m_itemsByGuest.end() && (!*it || *it == item))
+        d->m_itemsByGuest.erase(it);
+}
+
 int ItemContainer::visibleCount_recursive() const
 {
     int count = 0;
@@ -1608,10 +2140,16 @@ int ItemContainer::count_recursive() const
 
 Item *ItemContainer::itemAt(QPoint p) const
 {
-    for (Item *item : qAsConst(d->m_children)) {
-        if (item->isVisible() && item->geometry().contains(p))
-            return item;
-    }
+    // Visible children are laid out in order along our orientation, so binary search by their edge
+    const Item::List &children = d->hitTestChildren();
+    const int coordinate = Layouting::pos(p, d->m_orientation);
+    auto it = std::lower_bound(children.cbegin(), children.cend(), coordinate,
+                               [this] (const Item *item, int value) {
+        return item->m_sizingInfo.edge(d->m_orientation) < value;
+    });
+
+    if (it != children.cend() && (*it)->geometry().contains(p))
+        return *it;
 
     return nullptr;
 }
@@ -1647,7 +2185,7 @@ Item::List ItemContainer::items_recursive() const
 void ItemContainer::setHostWidget(Widget *host)
 {
     Item::setHostWidget(host);
-    d->deleteSeparators_recursive();
+    d->releaseSeparators_recursive();
     for (Item *item : qAsConst(d->m_children)) {
         item->setHostWidget(host);
     }
@@ -1686,6 +2224,7 @@ void ItemContainer::insertItem(Item *item, int index, DefaultSizeMode defaultSiz
     }
 
     d->m_children.insert(index, item);
+    invalidateCachedSizes();
     item->setParentContainer(this);
 
     Q_EMIT itemsChanged();
@@ -1777,6 +2316,7 @@ bool ItemContainer::contains_recursive(const Item *item) const
 void ItemContainer::setChildren(const Item::List children, Qt::Orientation o)
 {
     d->m_children = children;
+    invalidateCachedSizes();
     for (Item *item : children)
         item->setParentContainer(this);
 
@@ -1787,21 +2327,93 @@ void ItemContainer::setOrientation(Qt::Orientation o)
 {
     if (o != d->m_orientation) {
         d->m_orientation = o;
+        invalidateCachedSizes();
         d->updateSeparators_recursive();
     }
 }
 
 QSize ItemContainer::minSize() const
+{
+    if (d->m_minSizeDirty) {
+        d->m_cachedMinSize = d->calculateMinSize();
+        d->m_minSizeDirty = false;
+    }
+
+    return d->m_cachedMinSize;
+}
+
+QSize ItemContainer::maxSizeHint() const
+{
+    if (d->m_maxSizeHintDirty) {
+        d->m_cachedMaxSizeHint = d->calculateMaxSizeHint();
+        d->m_maxSizeHintDirty = false;
+    }
+
+    return d->m_cachedMaxSizeHint;
+}
+
+void ItemContainer::invalidateCachedSizes()
+{
+    // Our min/max sizes are an aggregate of our children's, so our ancestors are stale too.
+    // Same for which children are visible, as a container is visible if any of its children is.
+    ItemContainer *root = this;
+    for (ItemContainer *c = this; c; c = c->parentContainer()) {
+        c->d->m_minSizeDirty = true;
+        c->d->m_maxSizeHintDirty = true;
+        c->d->m_hitTestChildrenDirty = true;
+        root = c;
+    }
+
+    // Called for every change in children or orientation, so serve as a change notification too
+    root->d->m_generation = ++s_lastGeneration;
+}
+
+quint64 ItemContainer::generation() const
+{
+    return d->m_generation;
+}
+
+ItemArena *ItemContainer::arena() const
+{
+    return root()->d->m_arena;
+}
+
+void Item::markLayoutChanged()
+{
+    markLayoutChanged(root());
+}
+
+void Item::markLayoutChanged(ItemContainer *root)
+{
+    if (root)
+        root->d->m_generation = ++s_lastGeneration;
+}
+
+const Item::List &ItemContainer::Private::hitTestChildren() const
+{
+    if (m_hitTestChildrenDirty) {
+        m_hitTestChildren.clear();
+        for (Item *item : qAsConst(m_children)) {
+            if (item->isVisible())
+                m_hitTestChildren.push_back(item);
+        }
+        m_hitTestChildrenDirty = false;
+    }
+
+    return m_hitTestChildren;
+}
+
+QSize ItemContainer::Private::calculateMinSize() const
 {
     int minW = 0;
     int minH = 0;
     int numVisible = 0;
-    if (!d->m_children.isEmpty()) {
-        for (Item *item : qAsConst(d->m_children)) {
+    if (!m_children.isEmpty()) {
+        for (Item *item : qAsConst(m_children)) {
             if (!(item->isVisible() || item->isBeingInserted()))
                 continue;
             numVisible++;
-            if (isVertical()) {
+            if (q->isVertical()) {
                 minW = qMax(minW, item->minSize().width());
                 minH += item->minSize().height();
             } else {
@@ -1810,8 +2422,8 @@ QSize ItemContainer::minSize() const
             }
         }
 
-        const int separatorWaste = qMax(0, (numVisible - 1) * separatorThickness);
-        if (isVertical())
+        const int separatorWaste = qMax(0, (numVisible - 1) * Item::separatorThickness);
+        if (q->isVertical())
             minH += separatorWaste;
         else
             minW += separatorWaste;
@@ -1820,18 +2432,18 @@ QSize ItemContainer::minSize() const
     return QSize(minW, minH);
 }
 
-QSize ItemContainer::maxSizeHint() const
+QSize ItemContainer::Private::calculateMaxSizeHint() const
 {
-    int maxW = isVertical() ? KDDOCKWIDGETS_MAX_WIDTH : 0;
-    int maxH = isVertical() ? 0 : KDDOCKWIDGETS_MAX_HEIGHT;
+    int maxW = q->isVertical() ? KDDOCKWIDGETS_MAX_WIDTH : 0;
+    int maxH = q->isVertical() ? 0 : KDDOCKWIDGETS_MAX_HEIGHT;
 
-    const Item::List visibleChildren = this->visibleChildren();
+    const Item::List visibleChildren = q->visibleChildren();
     if (!visibleChildren.isEmpty()) {
         for (Item *item : visibleChildren) {
             const QSize itemMaxSz = item->maxSizeHint();
             const int itemMaxWidth = itemMaxSz.width();
             const int itemMaxHeight = itemMaxSz.height();
-            if (isVertical()) {
+            if (q->isVertical()) {
                 maxW = qMin(maxW, itemMaxWidth);
                 maxH = qMin(maxH + itemMaxHeight, KDDOCKWIDGETS_MAX_HEIGHT);
             } else {
@@ -1840,8 +2452,8 @@ QSize ItemContainer::maxSizeHint() const
             }
         }
 
-        const int separatorWaste = (visibleChildren.size() - 1) * separatorThickness;
-        if (isVertical()) {
+        const int separatorWaste = (visibleChildren.size() - 1) * Item::separatorThickness;
+        if (q->isVertical()) {
             maxH = qMin(maxH + separatorWaste, KDDOCKWIDGETS_MAX_HEIGHT);
         } else {
             maxW = qMin(maxW + separatorWaste, KDDOCKWIDGETS_MAX_WIDTH);
@@ -1854,7 +2466,7 @@ QSize ItemContainer::maxSizeHint() const
     if (maxH == 0)
         maxH = KDDOCKWIDGETS_MAX_HEIGHT;
 
-    return QSize(maxW, maxH).expandedTo(minSize());
+    return QSize(maxW, maxH).expandedTo(q->minSize());
 }
 
 void ItemContainer::Private::resizeChildren(QSize oldSize, QSize newSize, SizingInfo::List &childSizes,
@@ -1984,6 +2596,30 @@ void ItemContainer::Private::honourMaxSizes(SizingInfo::List &sizes)
     // We gathered who needs to shrink and who can grow, now try to do it evenly so that all
     // growers participate, and not just one giving everything.
 
+    if (!ItemContainer::s_useRoundRobinDistribution) {
+        QVector<int> growerCapacities;
+        growerCapacities.reserve(indexesOfGrowers.size());
+        for (int index : qAsConst(indexesOfGrowers))
+            growerCapacities.push_back(sizes.at(index).availableToGrow(m_orientation));
+
+        QVector<int> shrinkerCapacities;
+        shrinkerCapacities.reserve(indexesOfShrinkers.size());
+        for (int index : qAsConst(indexesOfShrinkers))
+            shrinkerCapacities.push_back(sizes.at(index).neededToShrink(m_orientation));
+
+        const QVector<int> growths = waterFill(growerCapacities, amountAvailableToGrow, RemainderMode::OneEach);
+        const QVector<int> shrinks = waterFill(shrinkerCapacities, amountNeededToShrink, RemainderMode::OneEach);
+
+        for (int i = 0; i < growths.size(); ++i)
+            sizes[indexesOfGrowers.at(i)].incrementLength(growths.at(i), m_orientation);
+        for (int i = 0; i < shrinks.size(); ++i)
+            sizes[indexesOfShrinkers.at(i)].incrementLength(-shrinks.at(i), m_orientation);
+
+        return;
+    }
+
+    // The original round-robin implementation. Kept for cross-checking.
+
     // Do the growing:
     while (amountAvailableToGrow > 0) {
         // Each grower will grow a bit (round-robin)
@@ -2231,10 +2867,10 @@ void ItemContainer::restoreChild(Item *item, NeighbourSqueezeStrategy neighbourS
     d->updateSeparators_recursive();
 }
 
-void ItemContainer::updateWidgetGeometries()
+void ItemContainer::updateWidgetGeometries_recursive()
 {
     for (Item *item : qAsConst(d->m_children))
-        item->updateWidgetGeometries();
+        item->updateWidgetGeometries_recursive();
 }
 
 int ItemContainer::oppositeLength() const
@@ -2391,7 +3027,9 @@ void ItemContainer::layoutEqually(SizingInfo::List &sizes)
     QVector<int> satisfiedIndexes;
     satisfiedIndexes.reserve(numItems);
 
-    int lengthToGive = length() - (d->m_separators.size() * Item::separatorThickness);
+    // Don't use m_separators.size(), as separators aren't updated during a transaction
+    const int numSeparators = qMax(0, numVisibleChildren() - 1);
+    int lengthToGive = length() - (numSeparators * Item::separatorThickness);
 
     // clear the sizes before we start distributing
     for (SizingInfo &size : sizes)
@@ -2867,8 +3505,13 @@ SizingInfo::List ItemContainer::sizes(bool ignoreBeingInserted) const
         if (item->isContainer()) {
             // Containers have virtual min/maxSize methods, and don't really fill in these properties
             // So fill them here
-            item->m_sizingInfo.minSize = item->minSize();
-            item->m_sizingInfo.maxSizeHint = item->maxSizeHint();
+            const QSize minSz = item->minSize();
+            const QSize maxSz = item->maxSizeHint();
+            if (minSz != item->m_sizingInfo.minSize || maxSz != item->m_sizingInfo.maxSizeHint) {
+                item->m_sizingInfo.minSize = minSz;
+                item->m_sizingInfo.maxSizeHint = maxSz;
+                item->markLayoutChanged(); // They're saved by toJsonObject()
+            }
         }
         result << item->m_sizingInfo;
     }
@@ -2890,7 +3533,16 @@ QVector<int> ItemContainer::calculateSqueezes(SizingInfo::List::ConstIterator be
     QVector<int> squeezes(count, 0);
     int missing = needed;
 
-    if (strategy == NeighbourSqueezeStrategy::AllNeighbours) {
+    if (strategy == NeighbourSqueezeStrategy::AllNeighbours && !s_useRoundRobinDistribution) {
+        squeezes = waterFill(availabilities, missing, RemainderMode::Greedy);
+        if (squeezes.isEmpty()) {
+            root()->dumpLayout();
+            Q_ASSERT(false);
+            return {};
+        }
+        missing = 0;
+    } else if (strategy == NeighbourSqueezeStrategy::AllNeighbours) {
+        // The original round-robin implementation. Kept for cross-checking.
         while (missing > 0) {
             const int numDonors = std::count_if(availabilities.cbegin(), availabilities.cend(), [] (int num) {
                 return num > 0;
@@ -2999,32 +3651,48 @@ void ItemContainer::Private::updateSeparators()
     if (!q->hostWidget())
         return;
 
+    if (q->isInTransaction()) {
+        // Separators are only created and positioned in commitTransaction()
+        q->updateChildPercentages();
+        return;
+    }
+
     const QVector<int> positions = requiredSeparatorPositions();
     const int requiredNumSeparators = positions.size();
 
     const bool numSeparatorsChanged = requiredNumSeparators != m_separators.size();
     if (numSeparatorsChanged) {
         // Instead of just creating N missing ones at the end of the list, let's minimize separators
-        // having their position changed, to minimize flicker
-        Separator::List newSeparators;
-        newSeparators.reserve(requiredNumSeparators);
-
-        for (int position : positions) {
-            Separator *separator = separatorAt(position);
-            if (separator) {
+        // having their position changed, to minimize flicker.
+        // Both lists are sorted by position, so match them in a single pass.
+        Separator::List newSeparators(requiredNumSeparators, nullptr);
+        Separator::List unusedSeparators;
+        int oldIndex = 0;
+        for (int i = 0; i < requiredNumSeparators; ++i) {
+            const int position = positions.at(i);
+            while (oldIndex < m_separators.size() && m_separators.at(oldIndex)->position() < position)
+                unusedSeparators.push_back(m_separators.at(oldIndex++));
+
+            if (oldIndex < m_separators.size() && m_separators.at(oldIndex)->position() == position) {
                 // Already existing, reuse
-                newSeparators.push_back(separator);
-                m_separators.removeOne(separator);
-            } else {
+                newSeparators[i] = m_separators.at(oldIndex++);
+            }
+        }
+
+        while (oldIndex < m_separators.size())
+            unusedSeparators.push_back(m_separators.at(oldIndex++));
+
+        // Return the unused ones to the pool, the missing ones will be taken from there
+        for (Separator *separator : qAsConst(unusedSeparators))
+            Config::self().releaseSeparator(separator);
+
+        for (Separator *&separator : newSeparators) {
+            if (!separator) {
                 separator = Config::self().createSeparator(q->hostWidget());
                 separator->init(q, m_orientation);
-                newSeparators.push_back(separator);
             }
         }
 
-        // delete what remained, which is unused
-        deleteSeparators();
-
         m_separators = newSeparators;
     }
 
@@ -3041,20 +3709,21 @@ void ItemContainer::Private::updateSeparators()
     q->updateChildPercentages();
 }
 
-void ItemContainer::Private::deleteSeparators()
+void ItemContainer::Private::releaseSeparators()
 {
-    qDeleteAll(m_separators);
+    for (Separator *separator : qAsConst(m_separators))
+        Config::self().releaseSeparator(separator);
     m_separators.clear();
 }
 
-void ItemContainer::Private::deleteSeparators_recursive()
+void ItemContainer::Private::releaseSeparators_recursive()
 {
-    deleteSeparators();
+    releaseSeparators();
 
     // recurse into the children:
     for (Item *item : qAsConst(m_children)) {
         if (auto c = item->asContainer())
-            c->d->deleteSeparators_recursive();
+            c->d->releaseSeparators_recursive();
     }
 }
 
@@ -3070,16 +3739,6 @@ void ItemContainer::Private::updateSeparators_recursive()
     }
 }
 
-Separator *ItemContainer::Private::separatorAt(int p) const
-{
-    for (Separator *separator : m_separators) {
-        if (separator->position() == p)
-            return separator;
-    }
-
-    return nullptr;
-}
-
 bool ItemContainer::isVertical() const
 {
     return d->m_orientation == Qt::Vertical;
@@ -3148,39 +3807,40 @@ int ItemContainer::maxPosForSeparator_global(Separator *separator, bool honourMa
     return separator->position() + availableToSqueeze;
 }
 
-QVariantMap ItemContainer::toVariantMap() const
+QJsonObject ItemContainer::toJsonObject() const
 {
-    QVariantMap result = Item::toVariantMap();
+    QJsonObject result = Item::toJsonObject();
 
-    QVariantList childrenV;
-    childrenV.reserve(d->m_children.size());
+    QJsonArray childrenJ;
     for (Item *child : qAsConst(d->m_children)) {
-        childrenV.push_back(child->toVariantMap());
+        childrenJ.append(child->toJsonObject());
     }
 
-    result[QStringLiteral("children")] = childrenV;
-    result[QStringLiteral("orientation")] = d->m_orientation;
+    result.insert(Keys::children, childrenJ);
+    result.insert(Keys::orientation, int(d->m_orientation));
 
     return result;
 }
 
-void ItemContainer::fillFromVariantMap(const QVariantMap &map,
+void ItemContainer::fillFromJsonObject(const QJsonObject &object,
                                        const QHash<QString, Widget*> &widgets)
 {
     QScopedValueRollback<bool> deserializing(d->m_isDeserializing, true);
 
-    Item::fillFromVariantMap(map, widgets);
-    const QVariantList childrenV = map[QStringLiteral("children")].toList();
-    d->m_orientation = Qt::Orientation(map[QStringLiteral("orientation")].toInt());
-
-    for (const QVariant &childV : childrenV) {
-        const QVariantMap childMap = childV.toMap();
-        const bool isContainer = childMap[QStringLiteral("isContainer")].toBool();
-        Item *child = isContainer ? new ItemContainer(hostWidget(), this)
-                                  : new Item(hostWidget(), this);
-        child->fillFromVariantMap(childMap, widgets);
+    Item::fillFromJsonObject(object, widgets);
+    const QJsonArray childrenJ = object.value(Keys::children).toArray();
+    d->m_orientation = Qt::Orientation(object.value(Keys::orientation).toInt());
+
+    d->m_children.reserve(childrenJ.size());
+    for (const QJsonValue &childJ : childrenJ) {
+        const QJsonObject childObject = childJ.toObject();
+        const bool isContainer = childObject.value(Keys::isContainer).toBool();
+        Item *child = isContainer ? new (arena()) ItemContainer(hostWidget(), this)
+                                  : new (arena()) Item(hostWidget(), this);
+        child->fillFromJsonObject(childObject, widgets);
         d->m_children.push_back(child);
     }
+    invalidateCachedSizes();
 
     if (isRoot()) {
         updateChildPercentages_recursive();
@@ -3200,6 +3860,103 @@ void ItemContainer::fillFromVariantMap(const QVariantMap &map,
     }
 }
 
+bool ItemContainer::canRestoreGeometries(const QJsonObject &object) const
+{
+    return Private::canRestoreGeometries(this, object);
+}
+
+bool ItemContainer::restoreGeometries(const QJsonObject &object)
+{
+    Q_ASSERT(isRoot());
+    if (!Private::canRestoreGeometries(this, object))
+        return false;
+
+    // Items whose geometry didn't change are left alone by setGeometry(). Widgets and separators
+    // are updated once, when the transaction is committed.
+    LayoutTransaction transaction(this);
+    Private::restoreGeometries(this, object);
+    updateChildPercentages_recursive();
+
+    return true;
+}
+
+bool ItemContainer::Private::canRestoreGeometries(const Item *item, const QJsonObject &object)
+{
+    if (item->isContainer() != object.value(Keys::isContainer).toBool()
+        || item->m_isVisible != object.value(Keys::isVisible).toBool())
+        return false;
+
+    // The min-sizes of the guests might have changed since the layout was saved
+    SizingInfo saved;
+    saved.fromJsonObject(object.value(Keys::sizingInfo).toObject());
+    const QSize minSize = item->minSize();
+    if (saved.geometry.width() < minSize.width() || saved.geometry.height() < minSize.height())
+        return false;
+
+    if (const ItemContainer *container = item->asContainer()) {
+        const QJsonArray childrenJ = object.value(Keys::children).toArray();
+        const Item::List &children = container->d->m_children;
+        if (container->d->m_orientation != Qt::Orientation(object.value(Keys::orientation).toInt())
+            || childrenJ.size() != children.size())
+            return false;
+
+        for (int i = 0; i < children.size(); ++i) {
+            if (!canRestoreGeometries(children.at(i), childrenJ.at(i).toObject()))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void ItemContainer::Private::restoreGeometries(Item *item, const QJsonObject &object)
+{
+    SizingInfo saved;
+    saved.fromJsonObject(object.value(Keys::sizingInfo).toObject());
+    item->setGeometry(saved.geometry);
+
+    if (ItemContainer *container = item->asContainer()) {
+        const QJsonArray childrenJ = object.value(Keys::children).toArray();
+        const Item::List &children = container->d->m_children;
+        for (int i = 0; i < children.size(); ++i)
+            restoreGeometries(children.at(i), childrenJ.at(i).toObject());
+    }
+}
+
+void ItemContainer::Private::copyFrom(const ItemContainer *other)
+{
+    // Equivalent to q->fillFromJsonObject(other->toJsonObject(), {}) but without the serialization
+    // round-trip. Used by suggestedDropRect(), which runs every time an indicator is hovered.
+    Q_ASSERT(isDummy());
+    Q_ASSERT(m_children.isEmpty());
+
+    QScopedValueRollback<bool> deserializing(m_isDeserializing, true);
+
+    q->copyStateFrom(other);
+    m_orientation = other->d->m_orientation;
+
+    m_children.reserve(other->d->m_children.size());
+    for (Item *otherChild : qAsConst(other->d->m_children)) {
+        Item *child = nullptr;
+        if (auto otherContainer = otherChild->asContainer()) {
+            auto container = new (q->arena()) ItemContainer(nullptr, q);
+            container->d->copyFrom(otherContainer);
+            child = container;
+        } else {
+            child = new (q->arena()) Item(nullptr, q);
+            child->copyStateFrom(otherChild);
+        }
+        m_children.push_back(child);
+    }
+    q->invalidateCachedSizes();
+
+    if (q->isRoot()) {
+        q->updateChildPercentages_recursive();
+        relayoutIfNeeded();
+        q->positionItems_recursive();
+    }
+}
+
 bool ItemContainer::Private::isDummy() const
 {
     return q->hostWidget() == nullptr;
@@ -3208,7 +3965,7 @@ bool ItemContainer::Private::isDummy() const
 #ifdef DOCKS_DEVELOPER_MODE
 bool ItemContainer::test_suggestedRect()
 {
-    auto itemToDrop = new Item(hostWidget());
+    auto itemToDrop = new (arena()) Item(hostWidget());
 
     const Item::List children = visibleChildren();
     for (Item *relativeTo : children) {
@@ -3400,21 +4157,21 @@ void SizingInfo::setOppositeLength(int l, Qt::Orientation o)
     setLength(l, oppositeOrientation(o));
 }
 
-QVariantMap SizingInfo::toVariantMap() const
+QJsonObject SizingInfo::toJsonObject() const
 {
-    QVariantMap result;
-    result[QStringLiteral("geometry")] = rectToMap(geometry);
-    result[QStringLiteral("minSize")] = sizeToMap(minSize);
-    result[QStringLiteral("maxSize")] = sizeToMap(maxSizeHint);
+    QJsonObject result;
+    result.insert(Keys::geometry, rectToJson(geometry));
+    result.insert(Keys::minSize, sizeToJson(minSize));
+    result.insert(Keys::maxSize, sizeToJson(maxSizeHint));
     return result;
 }
 
-void SizingInfo::fromVariantMap(const QVariantMap &map)
+void SizingInfo::fromJsonObject(const QJsonObject &object)
 {
     *this = SizingInfo(); // reset any non-important fields to their default
-    geometry = mapToRect(map[QStringLiteral("geometry")].toMap());
-    minSize = mapToSize(map[QStringLiteral("minSize")].toMap());
-    maxSizeHint = mapToSize(map[QStringLiteral("maxSize")].toMap());
+    geometry = jsonToRect(object.value(Keys::geometry).toObject());
+    minSize = jsonToSize(object.value(Keys::minSize).toObject());
+    maxSizeHint = jsonToSize(object.value(Keys::maxSize).toObject());
 }
 
 int ItemContainer::Private::defaultLengthFor(Item *item, DefaultSizeMode mode) const
@@ -23,11 +23,14 @@
 #include "multisplitter_export.h"
 
 #include <QObject>
+#include <QPointer>
 #include <QVector>
 #include <QRect>
 #include <QVariant>
+#include <QJsonObject>
 #include <QDebug>
 
+#include <cstddef>
 #include <memory>
 
 #define KDDOCKWIDGETS_MIN_WIDTH 80
@@ -199,8 +202,8 @@ struct SizingInfo {
         return qMax(0, length(o) - maxLengthHint(o));
     }
 
-    QVariantMap toVariantMap() const;
-    void fromVariantMap(const QVariantMap &);
+    QJsonObject toJsonObject() const;
+    void fromJsonObject(const QJsonObject &);
 
     typedef QVector<SizingInfo> List;
     QRect geometry;
@@ -210,6 +213,57 @@ struct SizingInfo {
     bool isBeingInserted = false;
 };
 
+/**
+ * @brief The memory the Items of a layout are allocated from
+ *
+ * Each root container has one, see ItemContainer::arena(). Items are carved from big chunks instead of
+ * being allocated one by one, and the memory of a deleted Item is reused by the next one of the same size.
+ * ItemContainer::clear() releases the chunks in one go, when none of its Items is left.
+ *
+ * The arena outlives its root if Items are still alive, as QObject deletes the root's children only
+ * after the root's destructor ran. It's then deleted with its last Item.
+ * Builds with AddressSanitizer allocate each Item separately, so use-after-free is still caught.
+ */
+class MULTISPLITTER_EXPORT ItemArena
+{
+public:
+    ///@brief Returns memory for an Item of @p size bytes. @p arena can be null, for a plain allocation
+    static void *allocate(ItemArena *arena, std::size_t size);
+    ///@brief Frees memory returned by allocate()
+    static void deallocate(void *ptr);
+
+    ///@brief Returns whether Items come from arenas. False in AddressSanitizer builds.
+    static bool isEnabled();
+
+    int numLiveItems() const;
+    int numChunks() const;
+private:
+    friend class ItemContainer;
+    struct Block;
+    struct FreeList {
+        std::size_t size;
+        Block *head;
+    };
+
+    ItemArena() = default;
+    ~ItemArena();
+    ///@brief Called when the owning root is destroyed
+    void releaseRoot();
+    ///@brief Frees all chunks but the first one, if no Item is left. Called by ItemContainer::clear()
+    void releaseUnused();
+    void recycle(Block *);
+    static std::size_t blockSizeFor(std::size_t itemSize);
+    ///@brief While in a free list, the Item's memory holds the next free block
+    static Block *&nextFreeBlock(Block *);
+
+    QVector<char*> m_chunks;
+    std::size_t m_usedInLastChunk = 0;
+    QVector<FreeList> m_freeLists;
+    int m_numLiveItems = 0;
+    bool m_hasRoot = true;
+    Q_DISABLE_COPY(ItemArena)
+};
+
 class MULTISPLITTER_EXPORT Item : public QObject
 {
     Q_OBJECT
@@ -249,6 +303,12 @@ public:
     explicit Item(Widget *hostWidget, ItemContainer *parent = nullptr);
     ~Item() override;
 
+    ///@brief Items are allocated from their layout's arena with new (arena) Item(...), see ItemArena
+    static void *operator new(std::size_t size);
+    static void *operator new(std::size_t size, ItemArena *arena);
+    static void operator delete(void *ptr);
+    static void operator delete(void *ptr, ItemArena *arena); // Only used if the constructor throws
+
     bool isRoot() const;
 
     virtual int visibleCount_recursive() const;
@@ -312,11 +372,11 @@ public:
     virtual void setGeometry_recursive(QRect rect);
     virtual void dumpLayout(int level = 0);
     virtual void setHostWidget(Widget *);
-    virtual QVariantMap toVariantMap() const;
-    virtual void fillFromVariantMap(const QVariantMap &map, const QHash<QString, Widget*> &widgets);
+    virtual QJsonObject toJsonObject() const;
+    virtual void fillFromJsonObject(const QJsonObject &object, const QHash<QString, Widget*> &widgets);
 
-    static Item* createFromVariantMap(Widget *hostWidget, ItemContainer *parent,
-                                      const QVariantMap &map, const QHash<QString, Widget *> &widgets);
+    static Item* createFromJsonObject(Widget *hostWidget, ItemContainer *parent,
+                                      const QJsonObject &object, const QHash<QString, Widget *> &widgets);
 
 Q_SIGNALS:
     void geometryChanged();
@@ -343,7 +403,9 @@ protected:
     int length(Qt::Orientation) const;
     int availableLength(Qt::Orientation) const;
     QSize missingSize() const;
-    virtual void updateWidgetGeometries();
+    void updateWidgetGeometries();
+    ///@brief Like updateWidgetGeometries(), for callers that already know there's no transaction open
+    virtual void updateWidgetGeometries_recursive();
     virtual void setIsVisible(bool);
     bool isBeingInserted() const;
     void setBeingInserted(bool);
@@ -360,7 +422,13 @@ private:
     bool eventFilter(QObject *o, QEvent *event) override;
     int m_refCount = 0;
     void updateObjectName();
-    void onWidgetDestroyed();
+    void onWidgetDestroyed(QObject *guest);
+    void copyStateFrom(const Item *other);
+    void emitGeometryChanged(QRect oldGeometry);
+    ///@brief Bumps the root's generation, as something toJsonObject() saves changed
+    void markLayoutChanged();
+    ///@brief Overload for when the caller already has the root, as walking up to it isn't free
+    static void markLayoutChanged(ItemContainer *root);
     bool m_isVisible = false;
     Widget *m_hostWidget = nullptr;
     Widget *m_guest = nullptr;
@@ -394,15 +462,75 @@ public:
     QSize availableSize() const;
     Item* itemForObject(const QObject *) const;
     Item* itemForWidget(const Widget *w) const;
+    ///@brief Returns the visible leaf item at @p p, which is in our coordinate space.
+    ///Binary searches each nesting level, so it's O(log n) per level.
+    Item *itemAt_recursive(QPoint p) const;
     Item::List items_recursive() const;
     Q_REQUIRED_RESULT bool checkSanity() override;
     void dumpLayout(int level = 0) override;
     void setSize_recursive(QSize newSize, ChildrenResizeStrategy strategy = ChildrenResizeStrategy::Percentage) override;
     QRect suggestedDropRect(const Item *item, const Item *relativeTo, Location) const;
-    QVariantMap toVariantMap() const override;
-    void fillFromVariantMap(const QVariantMap &map, const QHash<QString, Widget *> &widgets) override;
+    QJsonObject toJsonObject() const override;
+    void fillFromJsonObject(const QJsonObject &object, const QHash<QString, Widget *> &widgets) override;
+
+    /**
+     * @brief Returns whether restoreGeometries() can be called with @p object
+     *
+     * That's the case if @p object, as returned by toJsonObject(), has the same items, orientations
+     * and visibility as this tree, and its geometries still honour our min sizes.
+     */
+    bool canRestoreGeometries(const QJsonObject &object) const;
+
+    /**
+     * @brief Moves and resizes the items to the geometries saved in @p object, as returned by toJsonObject()
+     *
+     * Items aren't created nor removed, only items with a different geometry are changed.
+     * Returns false and does nothing if canRestoreGeometries() is false. Should be called on the root.
+     */
+    bool restoreGeometries(const QJsonObject &object);
     void clear();
+
+    /**
+     * @brief Starts a layout transaction. Should be called on the root container.
+     *
+     * While a transaction is in progress guest widget geometries, separators and geometry
+     * signals aren't updated. That's done once, when the outermost transaction is committed,
+     * so adding or restoring many items doesn't move each widget several times.
+     * Transactions can be nested. Prefer using LayoutTransaction instead.
+     */
+    void beginTransaction();
+
+    ///@brief Ends a transaction started with beginTransaction()
+    void commitTransaction();
+
+    ///@brief Returns whether our root container is in a transaction
+    bool isInTransaction() const;
+
+    /**
+     * @brief Tells the root container that clear() is going to be called soon
+     *
+     * Until then, removing or hiding items won't make their neighbours grow, nor update size
+     * constraints and separators, as clear() would throw that work away. Should be called on the root.
+     */
+    void aboutToClear();
+
+    ///@brief Returns whether aboutToClear() was called on our root, and clear() wasn't yet
+    bool isAboutToClear() const;
+
+    /**
+     * @brief Returns a value that changes whenever something toJsonObject() saves changes
+     * Only meaningful for the root container. Values are unique across layouts, so they can be
+     * used as keys for caching serialized state.
+     */
+    quint64 generation() const;
+
+    ///@brief Returns the arena our root's Items are allocated from
+    ItemArena *arena() const;
 private:
+    void deferGeometryChange(Item *item, QRect oldGeometry);
+    ///@brief Adds the guest of @p item, or of its descendants if it's a container, to root's index
+    void registerGuests(Item *item);
+    void unregisterGuest(const QObject *guest, const Item *item);
     bool isEmpty() const;
     bool hasOrientation() const;
     int numChildren() const;
@@ -426,7 +554,7 @@ private:
     QRect rect() const;
     void updateChildPercentages();
     void updateChildPercentages_recursive();
-    void updateWidgetGeometries() override;
+    void updateWidgetGeometries_recursive() override;
     int oppositeLength() const;
 
     void layoutEqually(SizingInfo::List &sizes);
@@ -470,6 +598,7 @@ private:
     int availableToGrowOnSide_recursive(const Item *child, Side, Qt::Orientation) const;
     void onChildMinSizeChanged(Item *child);
     void onChildVisibleChanged(Item *child, bool visible);
+    void invalidateCachedSizes();
     void updateSizeConstraints();
     SizingInfo::List sizes(bool ignoreBeingInserted = false) const;
     QVector<int> calculateSqueezes(SizingInfo::List::ConstIterator begin,
@@ -480,7 +609,6 @@ private:
     void positionItems_recursive();
     void positionItems(SizingInfo::List &sizes);
     Item *itemAt(QPoint p) const;
-    Item *itemAt_recursive(QPoint p) const;
     void setHostWidget(Widget *) override;
     void setIsVisible(bool) override;
     bool isVisible(bool excludeBeingInserted = false) const override;
@@ -493,6 +621,10 @@ private:
 
     int indexOf(Separator *) const;
 
+    ///@brief Debug switch to use the original round-robin loops in calculateSqueezes() and
+    ///honourMaxSizes() instead of the water-filling. Both must give the same results.
+    static bool s_useRoundRobinDistribution;
+
 #ifdef DOCKS_DEVELOPER_MODE
     bool test_suggestedRect();
 #endif
@@ -511,4 +643,16 @@ private:
     Private *const d;
 };
 
+///@brief RAII helper that begins a layout transaction on construction and commits it on destruction
+///@sa ItemContainer::beginTransaction()
+class MULTISPLITTER_EXPORT LayoutTransaction
+{
+public:
+    explicit LayoutTransaction(ItemContainer *root);
+    ~LayoutTransaction();
+private:
+    Q_DISABLE_COPY(LayoutTransaction)
+    const QPointer<ItemContainer> m_root;
+};
+
 }
@@ -30,19 +30,72 @@
 namespace Layouting
 {
 
+// More than this and the host has way more separators hidden than it will ever show again
+static const int s_maxPooledSeparatorsPerHost = 32;
+
 Config::Config()
 {
     registerQmlTypes();
 }
 
-Separator *Config::createSeparator(Widget *parent) const
+Separator *Config::createSeparator(Widget *parent)
 {
+    auto it = m_separatorPools.find(parent ? parent->asQObject() : nullptr);
+    if (it != m_separatorPools.end() && !it->separators.isEmpty())
+        return it->separators.takeLast();
+
     if (m_separatorFactoryFunc)
         return m_separatorFactoryFunc(parent);
 
     return nullptr;
 }
 
+void Config::releaseSeparator(Separator *separator)
+{
+    if (!separator)
+        return;
+
+    QObject *host = separator->host();
+    auto it = m_separatorPools.find(host);
+    if (!host || (it != m_separatorPools.end() && it->separators.size() >= s_maxPooledSeparatorsPerHost)) {
+        delete separator;
+        return;
+    }
+
+    separator->onReleased();
+
+    if (it == m_separatorPools.end()) {
+        // Pooled separators are children of the host, so they die with it
+        it = m_separatorPools.insert(host, {});
+        it->hostDestroyedConnection = QObject::connect(host, &QObject::destroyed, host, [this, host] {
+            removeSeparatorPool(host);
+        });
+    }
+
+    it->separators.push_back(separator);
+}
+
+void Config::removeSeparatorPool(const QObject *host)
+{
+    auto it = m_separatorPools.find(host);
+    if (it == m_separatorPools.end())
+        return;
+
+    QObject::disconnect(it->hostDestroyedConnection);
+    m_separatorPools.erase(it);
+}
+
+void Config::clearSeparatorPools()
+{
+    // Separators read the flags and are made by the factory when created, so pooled ones can't be reused
+    for (const SeparatorPool &pool : qAsConst(m_separatorPools)) {
+        QObject::disconnect(pool.hostDestroyedConnection);
+        qDeleteAll(pool.separators);
+    }
+
+    m_separatorPools.clear();
+}
+
 void Config::registerQmlTypes()
 {
 #ifdef KDMULTISPLITTER_QTQUICK
@@ -59,6 +112,9 @@ Config &Config::self()
 
 Config::~Config()
 {
+    // Hosts might outlive us, at shutdown
+    for (const SeparatorPool &pool : qAsConst(m_separatorPools))
+        QObject::disconnect(pool.hostDestroyedConnection);
 }
 
 int Config::separatorThickness() const
@@ -84,6 +140,9 @@ void Config::setSeparatorFactoryFunc(SeparatorFactoryFunc func)
         return;
     }
 
+    if (m_separatorFactoryFunc != func)
+        clearSeparatorPools();
+
     m_separatorFactoryFunc = func;
 }
 
@@ -104,6 +163,7 @@ void Config::setFlags(Flags flags)
 
     // validations here, if any
 
+    clearSeparatorPools();
     m_flags = flags;
 }
 
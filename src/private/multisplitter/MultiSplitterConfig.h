@@ -23,6 +23,13 @@
 #include "multisplitter_export.h"
 
 #include <qglobal.h>
+#include <QHash>
+#include <QVector>
+#include <QMetaObject>
+
+QT_BEGIN_NAMESPACE
+class QObject;
+QT_END_NAMESPACE
 
 namespace Layouting {
 
@@ -36,7 +43,8 @@ public:
 
     enum class Flag {
         None = 0,
-        LazyResize = 1
+        LazyResize = 1,
+        FramePacedResize = 2 ///< Separator moves are applied at most once per display frame
     };
     Q_DECLARE_FLAGS(Flags, Flag);
 
@@ -74,13 +82,32 @@ private:
     friend class ItemContainer;
 
     Config();
-    Separator* createSeparator(Layouting::Widget *) const;
+
+    ///@brief Returns a separator for the host widget @p parent. Reuses a pooled one if available.
+    Separator* createSeparator(Layouting::Widget *parent);
+
+    ///@brief Hides @p separator and keeps it for reuse by a later createSeparator() with the same host
+    void releaseSeparator(Separator *separator);
 
     void registerQmlTypes();
 
     SeparatorFactoryFunc m_separatorFactoryFunc = nullptr;
     Flags m_flags = Flag::None;
 
+    ///@brief Hidden separators of a host widget. Separators are widgets, and creating them is expensive.
+    struct SeparatorPool {
+        QVector<Separator*> separators;
+        QMetaObject::Connection hostDestroyedConnection;
+    };
+
+    ///@brief Drops the pool of @p host. Pooled separators are children of the host, so it deletes them.
+    void removeSeparatorPool(const QObject *host);
+
+    ///@brief Deletes all pooled separators. Called when the flags or the separator factory change.
+    void clearSeparatorPools();
+
+    QHash<const QObject*, SeparatorPool> m_separatorPools;
+
     Q_DISABLE_COPY(Config);
 };
 
@@ -25,6 +25,8 @@
 #include "MultiSplitterConfig.h"
 
 #include <QGuiApplication>
+#include <QScreen>
+#include <QTimer>
 
 #ifdef Q_OS_WIN
 # include <windows.h>
@@ -34,6 +36,18 @@ using namespace Layouting;
 
 Separator* Separator::s_separatorBeingDragged = nullptr;
 
+///@brief Returns the screen containing @p globalPos, or the primary screen if there's none
+static QScreen *screenAt(QPoint globalPos)
+{
+    const auto screens = QGuiApplication::screens();
+    for (QScreen *screen : screens) {
+        if (screen->geometry().contains(globalPos))
+            return screen;
+    }
+
+    return QGuiApplication::primaryScreen();
+}
+
 struct Separator::Private
 {
     // Only set when anchor is moved through mouse. Side1 if going towards left or top, Side2 otherwise.
@@ -49,6 +63,11 @@ struct Separator::Private
     ItemContainer *parentContainer = nullptr;
     Layouting::Side lastMoveDirection = Side1;
     const bool usesLazyResize = Config::self().flags() & Config::Flag::LazyResize;
+    const bool usesFramePacedResize = Config::self().flags() & Config::Flag::FramePacedResize;
+    // Only used with Config::Flag::FramePacedResize
+    bool hasPendingMove = false;
+    bool pendingMoveScheduled = false;
+    int pendingPosition = 0;
     Widget *const m_hostWidget;
 };
 
@@ -127,7 +146,11 @@ void Separator::onMouseMove(QPoint pos)
     }
 #endif
 
-    const int positionToGoTo = Layouting::pos(pos, d->orientation);
+    dragTo(Layouting::pos(pos, d->orientation));
+}
+
+void Separator::dragTo(int positionToGoTo)
+{
     const int minPos = d->parentContainer->minPosForSeparator_global(this);
     const int maxPos = d->parentContainer->maxPosForSeparator_global(this);
 
@@ -138,10 +161,15 @@ void Separator::onMouseMove(QPoint pos)
                                                        : (positionToGoTo > position() ? Side2
                                                                                       : Side2); // Last case shouldn't happen though.
 
-    if (d->lazyResizeRubberBand)
+    if (d->lazyResizeRubberBand) {
         setLazyPosition(positionToGoTo);
-    else
+    } else if (d->usesFramePacedResize) {
+        d->pendingPosition = positionToGoTo;
+        d->hasPendingMove = true;
+        schedulePendingMove();
+    } else {
         d->parentContainer->requestSeparatorMove(this, positionToGoTo - position());
+    }
 }
 
 void Separator::onMouseReleased()
@@ -149,11 +177,48 @@ void Separator::onMouseReleased()
     if (d->lazyResizeRubberBand) {
         d->lazyResizeRubberBand->hide();
         d->parentContainer->requestSeparatorMove(this, d->lazyPosition - position());
+    } else {
+        // Don't lose the last position
+        applyPendingMove();
     }
 
     s_separatorBeingDragged = nullptr;
 }
 
+void Separator::schedulePendingMove()
+{
+    if (d->pendingMoveScheduled)
+        return;
+
+    // Mice can report moves much faster than we can paint, coalesce them into one per frame.
+    // Use the rate of the screen we're on, screens can have different ones.
+    QScreen *screen = screenAt(asWidget()->mapToGlobal(QPoint(0, 0)));
+    const qreal refreshRate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60;
+    const int interval = qMax(1, qRound(1000 / refreshRate));
+
+    d->pendingMoveScheduled = true;
+    QTimer::singleShot(interval, asWidget()->asQObject(), [this] {
+        d->pendingMoveScheduled = false;
+        applyPendingMove();
+    });
+}
+
+void Separator::applyPendingMove()
+{
+    if (!d->hasPendingMove || !d->parentContainer)
+        return;
+
+    d->hasPendingMove = false;
+
+    // The layout might have changed meanwhile
+    const int minPos = d->parentContainer->minPosForSeparator_global(this);
+    const int maxPos = d->parentContainer->maxPosForSeparator_global(this);
+    if (d->pendingPosition < minPos || d->pendingPosition > maxPos)
+        return;
+
+    d->parentContainer->requestSeparatorMove(this, d->pendingPosition - position());
+}
+
 void Separator::setGeometry(QRect r)
 {
     if (r != d->geometry) {
@@ -185,11 +250,25 @@ void Separator::init(ItemContainer *parentContainer, Qt::Orientation orientation
 
     d->parentContainer = parentContainer;
     d->orientation = orientation;
-    d->lazyResizeRubberBand = d->usesLazyResize ? createRubberBand(d->m_hostWidget)
-                                                : nullptr;
+    if (d->usesLazyResize && !d->lazyResizeRubberBand) // Might be a pooled separator being reused
+        d->lazyResizeRubberBand = createRubberBand(d->m_hostWidget);
     asWidget()->setVisible(true);
 }
 
+void Separator::onReleased()
+{
+    if (isBeingDragged())
+        s_separatorBeingDragged = nullptr;
+
+    if (d->lazyResizeRubberBand)
+        d->lazyResizeRubberBand->hide();
+
+    d->hasPendingMove = false;
+    d->parentContainer = nullptr;
+    d->geometry = QRect();
+    asWidget()->setVisible(false);
+}
+
 ItemContainer *Separator::parentContainer() const
 {
     return d->parentContainer;
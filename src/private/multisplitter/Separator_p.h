@@ -26,6 +26,8 @@
 #include <QObject>
 #include <QPoint>
 
+class TestMultiSplitter;
+
 namespace Layouting {
 
 class Config;
@@ -65,8 +67,15 @@ protected:
     void onMouseMove(QPoint pos);
 private:
     friend class Config;
+    friend class ::TestMultiSplitter;
 
     void setLazyPosition(int);
+    ///@brief Moves the separator to @p positionToGoTo, or schedules it, depending on the flags
+    void dragTo(int positionToGoTo);
+    void schedulePendingMove();
+    void applyPendingMove();
+    ///@brief Called by Config when we're put into the pool, for later reuse
+    void onReleased();
     bool isBeingDragged() const;
     bool usesLazyResize() const;
     static bool s_isResizing;
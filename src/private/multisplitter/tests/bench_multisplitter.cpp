@@ -0,0 +1,399 @@
+/*
+  This file is part of KDDockWidgets.
+
+  Copyright (C) 2018-2020 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+  Author: Sérgio Martins <sergio.martins@kdab.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Headless benchmark for the layouting engine.
+ *
+ * Builds trees of Item/ItemContainer of varying size and depth, without any QWidget or QtQuick,
+ * and times the hot operations. Results are printed to stdout, one record per line, either as
+ * JSON (default) or as CSV (--csv), so they can be diffed or plotted between runs.
+ */
+
+#include "Item_p.h"
+#include "Separator_p.h"
+#include "Widget.h"
+#include "MultiSplitterConfig.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+using namespace Layouting;
+
+namespace {
+
+///@brief A Widget that only stores its geometry. Used as host, so we get real separators
+///without needing a display
+class HeadlessWidget : public QObject
+                     , public Widget
+{
+public:
+    explicit HeadlessWidget(QObject *parent = nullptr)
+        : QObject(parent)
+        , Widget(this)
+    {
+    }
+
+    void setLayoutItem(Item *) override {}
+    QSize minSize() const override { return {}; }
+    QSize maxSizeHint() const override { return QSize(KDDOCKWIDGETS_MAX_WIDTH, KDDOCKWIDGETS_MAX_HEIGHT); }
+    QRect geometry() const override { return m_geometry; }
+    void setGeometry(QRect geo) override { m_geometry = geo; }
+    void setParent(Widget *parent) override { QObject::setParent(parent ? parent->asQObject() : nullptr); }
+    QDebug& dumpDebug(QDebug &dbg) const override { dbg << "HeadlessWidget" << m_geometry; return dbg; }
+    bool isVisible() const override { return m_isVisible; }
+    void setVisible(bool is) const override { m_isVisible = is; }
+    void move(int x, int y) override { m_geometry.moveTopLeft(QPoint(x, y)); }
+    void setSize(int width, int height) override { m_geometry.setSize(QSize(width, height)); }
+    void setWidth(int width) override { m_geometry.setWidth(width); }
+    void setHeight(int height) override { m_geometry.setHeight(height); }
+    std::unique_ptr<Widget> parentWidget() const override { return {}; }
+    std::unique_ptr<Widget> topLevel() const override { return {}; }
+    void show() override { setVisible(true); }
+    void hide() override { setVisible(false); }
+    void update() override {}
+    QPoint mapFromGlobal(QPoint p) const override { return p - m_geometry.topLeft(); }
+    QPoint mapToGlobal(QPoint p) const override { return p + m_geometry.topLeft(); }
+
+private:
+    QRect m_geometry;
+    mutable bool m_isVisible = false;
+};
+
+class HeadlessSeparator : public HeadlessWidget
+                        , public Separator
+{
+public:
+    explicit HeadlessSeparator(Widget *host)
+        : HeadlessWidget(host ? host->asQObject() : nullptr)
+        , Separator(host)
+    {
+    }
+
+    Widget *asWidget() override { return this; }
+};
+
+Separator *createHeadlessSeparator(Widget *host)
+{
+    return new HeadlessSeparator(host);
+}
+
+struct Options
+{
+    QVector<int> sizes;
+    QVector<int> depths;
+    int iterations = 20;
+    quint32 seed = 42;
+    bool csv = false;
+};
+
+class Reporter
+{
+public:
+    explicit Reporter(bool csv)
+        : m_csv(csv)
+        , m_out(stdout)
+    {
+        if (m_csv)
+            m_out << "benchmark,items,depth,iterations,total_ns,mean_ns,median_ns,min_ns,max_ns\n";
+    }
+
+    void report(const QString &name, int numItems, int depth, QVector<qint64> samples)
+    {
+        if (samples.isEmpty())
+            return;
+
+        std::sort(samples.begin(), samples.end());
+        qint64 total = 0;
+        for (qint64 s : qAsConst(samples))
+            total += s;
+
+        const qint64 mean = total / samples.size();
+        const qint64 median = samples.at(samples.size() / 2);
+
+        if (m_csv) {
+            m_out << name << ',' << numItems << ',' << depth << ',' << samples.size() << ','
+                  << total << ',' << mean << ',' << median << ','
+                  << samples.first() << ',' << samples.last() << '\n';
+        } else {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("benchmark"), name);
+            obj.insert(QStringLiteral("items"), numItems);
+            obj.insert(QStringLiteral("depth"), depth);
+            obj.insert(QStringLiteral("iterations"), samples.size());
+            obj.insert(QStringLiteral("total_ns"), double(total));
+            obj.insert(QStringLiteral("mean_ns"), double(mean));
+            obj.insert(QStringLiteral("median_ns"), double(median));
+            obj.insert(QStringLiteral("min_ns"), double(samples.first()));
+            obj.insert(QStringLiteral("max_ns"), double(samples.last()));
+            m_out << QJsonDocument(obj).toJson(QJsonDocument::Compact) << '\n';
+        }
+
+        m_out.flush();
+    }
+
+private:
+    const bool m_csv;
+    QTextStream m_out;
+};
+
+Item *createLeaf(Widget *host)
+{
+    auto item = new Item(host);
+    item->setMinSize(QSize(10, 10));
+    item->setGeometry(QRect(0, 0, 100, 100));
+    return item;
+}
+
+int nestingLevel(const Item *item)
+{
+    int level = 0;
+    for (ItemContainer *c = item->parentContainer(); c; c = c->parentContainer())
+        ++level;
+    return level;
+}
+
+Item::Location locationFor(Qt::Orientation orientation, bool side1)
+{
+    if (orientation == Qt::Horizontal)
+        return side1 ? Item::Location_OnLeft : Item::Location_OnRight;
+    return side1 ? Item::Location_OnTop : Item::Location_OnBottom;
+}
+
+Qt::Orientation opposite(Qt::Orientation o)
+{
+    return o == Qt::Horizontal ? Qt::Vertical : Qt::Horizontal;
+}
+
+///@brief Inserts @p numItems leaves into @p root, nesting at most @p maxDepth levels deep.
+///Each insertion time is appended to @p samples, if not null
+Item::List populate(ItemContainer *root, int numItems, int maxDepth, std::mt19937 &rng,
+                    QVector<qint64> *samples = nullptr)
+{
+    Item::List leaves;
+    leaves.reserve(numItems);
+    QElapsedTimer timer;
+
+    for (int i = 0; i < numItems; ++i) {
+        Item *leaf = createLeaf(root->hostWidget());
+        const bool side1 = rng() % 2;
+
+        if (leaves.isEmpty()) {
+            timer.start();
+            root->insertItem(leaf, Item::Location_OnRight);
+        } else {
+            Item *relativeTo = leaves.at(int(rng() % quint32(leaves.size())));
+            const Qt::Orientation parentOrientation = relativeTo->parentContainer()->orientation();
+
+            // Nesting happens when inserting in the orientation orthogonal to the parent's
+            const bool nest = nestingLevel(relativeTo) < maxDepth && rng() % 2;
+            const Item::Location loc = locationFor(nest ? opposite(parentOrientation) : parentOrientation, side1);
+            timer.start();
+            relativeTo->insertItem(leaf, loc);
+        }
+
+        if (samples)
+            samples->append(timer.nsecsElapsed());
+        leaves.append(leaf);
+    }
+
+    return leaves;
+}
+
+void benchmarkTree(const Options &opts, Reporter &reporter, int numItems, int depth)
+{
+    std::mt19937 rng(opts.seed);
+    QElapsedTimer timer;
+    QVector<qint64> samples;
+
+    // insertItem
+    std::unique_ptr<ItemContainer> root(new ItemContainer(nullptr));
+    root->setSize(QSize(1000, 1000));
+    Item::List leaves = populate(root.get(), numItems, depth, rng, &samples);
+    reporter.report(QStringLiteral("insertItem"), numItems, depth, samples);
+
+    // setSize_recursive, alternating between growing and shrinking
+    samples.clear();
+    const QSize originalSize = root->size();
+    for (int i = 0; i < opts.iterations; ++i) {
+        const QSize newSize = i % 2 ? originalSize : originalSize + QSize(originalSize.width() / 10,
+                                                                          originalSize.height() / 10);
+        timer.start();
+        root->setSize_recursive(newSize);
+        samples.append(timer.nsecsElapsed());
+    }
+    reporter.report(QStringLiteral("setSize_recursive"), numItems, depth, samples);
+
+    // suggestedDropRect, relative to random leaves and to the window edges
+    samples.clear();
+    {
+        std::unique_ptr<Item> itemToDrop(createLeaf(nullptr));
+        for (int i = 0; i < opts.iterations; ++i) {
+            const auto loc = Item::Location(Item::Location_OnLeft + int(rng() % 4));
+            const bool outer = i % 4 == 0;
+            Item *relativeTo = outer ? nullptr : leaves.at(int(rng() % quint32(leaves.size())));
+            ItemContainer *container = outer ? root.get() : relativeTo->parentContainer();
+            timer.start();
+            container->suggestedDropRect(itemToDrop.get(), relativeTo, loc);
+            samples.append(timer.nsecsElapsed());
+        }
+    }
+    reporter.report(QStringLiteral("suggestedDropRect"), numItems, depth, samples);
+
+    // toJsonObject
+    samples.clear();
+    QJsonObject serialized;
+    for (int i = 0; i < opts.iterations; ++i) {
+        timer.start();
+        serialized = root->toJsonObject();
+        samples.append(timer.nsecsElapsed());
+    }
+    reporter.report(QStringLiteral("toJsonObject"), numItems, depth, samples);
+
+    // fillFromJsonObject
+    samples.clear();
+    for (int i = 0; i < opts.iterations; ++i) {
+        ItemContainer restored(nullptr);
+        timer.start();
+        restored.fillFromJsonObject(serialized, {});
+        samples.append(timer.nsecsElapsed());
+    }
+    reporter.report(QStringLiteral("fillFromJsonObject"), numItems, depth, samples);
+
+    // removeItem, in random order, until the layout is empty
+    samples.clear();
+    std::shuffle(leaves.begin(), leaves.end(), rng);
+    for (Item *leaf : qAsConst(leaves)) {
+        timer.start();
+        leaf->parentContainer()->removeItem(leaf);
+        samples.append(timer.nsecsElapsed());
+    }
+    reporter.report(QStringLiteral("removeItem"), numItems, depth, samples);
+}
+
+void benchmarkSeparators(const Options &opts, Reporter &reporter, int numItems, int depth)
+{
+    // Separators only exist when there's a host widget, so use a headless one
+    std::mt19937 rng(opts.seed);
+    HeadlessWidget host;
+    std::unique_ptr<ItemContainer> root(new ItemContainer(&host));
+    root->setSize(QSize(1000, 1000));
+    populate(root.get(), numItems, depth, rng);
+
+    const QVector<Separator*> separators = root->separators_recursive();
+    if (separators.isEmpty())
+        return;
+
+    QElapsedTimer timer;
+    QVector<qint64> samples;
+    for (int i = 0; i < opts.iterations; ++i) {
+        Separator *separator = separators.at(int(rng() % quint32(separators.size())));
+        ItemContainer *container = separator->parentContainer();
+        const int pos = separator->position();
+        const int min = container->minPosForSeparator_global(separator);
+        const int max = container->maxPosForSeparator_global(separator);
+
+        // Move towards whichever side has room, by at most 10px
+        const int delta = max - pos >= pos - min ? qMin(10, max - pos) : -qMin(10, pos - min);
+        if (delta == 0)
+            continue;
+
+        timer.start();
+        container->requestSeparatorMove(separator, delta);
+        samples.append(timer.nsecsElapsed());
+    }
+
+    reporter.report(QStringLiteral("requestSeparatorMove"), numItems, depth, samples);
+    root.reset(); // before the host goes away
+}
+
+QVector<int> parseIntList(const QString &str)
+{
+    QVector<int> result;
+    const QStringList parts = str.split(QLatin1Char(','));
+    for (const QString &part : parts) {
+        // Empty parts don't parse as a number, so they're skipped too
+        bool ok = false;
+        const int value = part.trimmed().toInt(&ok);
+        if (ok && value > 0)
+            result.append(value);
+    }
+
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Headless benchmark for the layouting engine"));
+    parser.addHelpOption();
+
+    QCommandLineOption sizesOption(QStringLiteral("sizes"),
+                                   QStringLiteral("Comma separated list of item counts"),
+                                   QStringLiteral("list"), QStringLiteral("10,100,1000,5000"));
+    QCommandLineOption depthsOption(QStringLiteral("depths"),
+                                    QStringLiteral("Comma separated list of maximum nesting depths"),
+                                    QStringLiteral("list"), QStringLiteral("1,3,8"));
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+                                        QStringLiteral("Iterations for each per-layout benchmark"),
+                                        QStringLiteral("n"), QStringLiteral("20"));
+    QCommandLineOption seedOption(QStringLiteral("seed"),
+                                  QStringLiteral("Seed for the layout generator"),
+                                  QStringLiteral("n"), QStringLiteral("42"));
+    QCommandLineOption csvOption(QStringLiteral("csv"), QStringLiteral("Output CSV instead of JSON lines"));
+
+    parser.addOption(sizesOption);
+    parser.addOption(depthsOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(seedOption);
+    parser.addOption(csvOption);
+    parser.process(app);
+
+    Options opts;
+    opts.sizes = parseIntList(parser.value(sizesOption));
+    opts.depths = parseIntList(parser.value(depthsOption));
+    opts.iterations = qMax(1, parser.value(iterationsOption).toInt());
+    opts.seed = parser.value(seedOption).toUInt();
+    opts.csv = parser.isSet(csvOption);
+
+    Config::self().setSeparatorFactoryFunc(createHeadlessSeparator);
+
+    Reporter reporter(opts.csv);
+    for (int numItems : qAsConst(opts.sizes)) {
+        for (int depth : qAsConst(opts.depths)) {
+            benchmarkTree(opts, reporter, numItems, depth);
+            benchmarkSeparators(opts, reporter, numItems, depth);
+        }
+    }
+
+    return 0;
+}
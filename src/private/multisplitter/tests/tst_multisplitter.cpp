@@ -28,6 +28,7 @@
 #include <QtTest/QtTest>
 
 #include <memory.h>
+#include <random>
 
 
 // TODO: namespace
@@ -175,6 +176,7 @@ private Q_SLOTS:
     void tst_suggestedRect2();
     void tst_suggestedRect3();
     void tst_suggestedRect4();
+    void tst_suggestedRectMatchesSerializedCopy();
     void tst_insertAnotherRoot();
     void tst_misc1();
     void tst_misc2();
@@ -201,6 +203,15 @@ private Q_SLOTS:
     void tst_maxSizeHonoured3();
     void tst_requestEqualSize();
     void tst_maxSizeHonouredWhenAnotherRemoved();
+    void tst_transaction();
+    void tst_itemForWidget();
+    void tst_itemAt();
+    void tst_waterFillMatchesRoundRobin();
+    void tst_separatorsAreReused();
+    void tst_itemArena();
+    void tst_generation();
+    void tst_aboutToClear();
+    void tst_framePacedSeparatorMove();
 };
 
 class MyHostWidget : public QWidget
@@ -231,7 +242,7 @@ static bool serializeDeserializeTest(const std::unique_ptr<ItemContainer> &root)
     if (!root->checkSanity())
         return false;
 
-    const QVariantMap serialized = root->toVariantMap();
+    const QJsonObject serialized = root->toJsonObject();
     ItemContainer root2(root->hostWidget());
 
     QHash<QString, Widget*> widgets;
@@ -240,7 +251,7 @@ static bool serializeDeserializeTest(const std::unique_ptr<ItemContainer> &root)
         if (auto w = static_cast<MyGuestWidget*>(item->guestAsQObject()))
             widgets.insert(w->id(), w);
 
-    root2.fillFromVariantMap(serialized, widgets);
+    root2.fillFromJsonObject(serialized, widgets);
 
     return root2.checkSanity();
 }
@@ -981,6 +992,66 @@ void TestMultiSplitter::tst_suggestedRect4()
     delete itemToDrop;
 }
 
+static QRect suggestedDropRectViaSerialization(ItemContainer *container, const Item *item,
+                                               const Item *relativeTo, Item::Location loc)
+{
+    // The old way of calculating the drop rect, which copied the layout via QJsonObject
+    ItemContainer rootCopy(nullptr);
+    rootCopy.fillFromJsonObject(container->root()->toJsonObject(), {});
+
+    if (relativeTo)
+        relativeTo = rootCopy.d->itemFromPath(relativeTo->pathFromRoot());
+
+    auto itemCopy = new Item(nullptr);
+    itemCopy->fillFromJsonObject(item->toJsonObject(), {});
+
+    if (relativeTo) {
+        const_cast<Item*>(relativeTo)->insertItem(itemCopy, loc, Item::DefaultSizeMode::FairButFloor);
+    } else {
+        rootCopy.insertItem(itemCopy, loc, Item::DefaultSizeMode::FairButFloor);
+    }
+
+    return itemCopy->mapToRoot(itemCopy->rect());
+}
+
+void TestMultiSplitter::tst_suggestedRectMatchesSerializedCopy()
+{
+    // Tests that copying the layout directly gives the same drop rects as the serialization round-trip
+
+    auto root = createRoot();
+    Item *item1 = createItem();
+    Item *item2 = createItem(QSize(150, 150));
+    Item *item3 = createItem();
+    Item *item4 = createItem(QSize(100, 300));
+    Item *item5 = createItem();
+    root->insertItem(item1, Item::Location_OnLeft);
+    root->insertItem(item2, Item::Location_OnRight);
+    item2->insertItem(item3, Item::Location_OnBottom);
+    item3->insertItem(item4, Item::Location_OnRight);
+    root->insertItem(item5, Item::Location_OnBottom, Item::DefaultSizeMode::Fair, Item::AddingOption_StartHidden);
+    QVERIFY(root->checkSanity());
+
+    Item itemBeingDropped(nullptr);
+    itemBeingDropped.setMinSize(QSize(100, 100));
+    itemBeingDropped.setSize(QSize(300, 250));
+
+    const Item::Location locations[] = { Item::Location_OnLeft, Item::Location_OnTop,
+                                         Item::Location_OnRight, Item::Location_OnBottom };
+
+    for (Item::Location loc : locations) {
+        QCOMPARE(root->suggestedDropRect(&itemBeingDropped, nullptr, loc),
+                 suggestedDropRectViaSerialization(root.get(), &itemBeingDropped, nullptr, loc));
+
+        for (Item *relativeTo : root->items_recursive()) {
+            if (!relativeTo->isVisible())
+                continue;
+            ItemContainer *container = relativeTo->parentContainer();
+            QCOMPARE(container->suggestedDropRect(&itemBeingDropped, relativeTo, loc),
+                     suggestedDropRectViaSerialization(container, &itemBeingDropped, relativeTo, loc));
+        }
+    }
+}
+
 void TestMultiSplitter::tst_insertAnotherRoot()
 {
     {
@@ -1807,6 +1878,350 @@ void TestMultiSplitter::tst_maxSizeHonouredWhenAnotherRemoved()
     root->dumpLayout();
 }
 
+void TestMultiSplitter::tst_transaction()
+{
+    // Tests that widgets, separators and geometry signals are only updated when the transaction is committed
+    auto root = createRoot();
+    auto item1 = createItem();
+    root->insertItem(item1, Item::Location_OnLeft);
+    QVERIFY(root->checkSanity());
+
+    QSignalSpy item1Spy(item1, &Item::geometryChanged);
+    auto guest1 = static_cast<MyGuestWidget*>(item1->guestAsQObject());
+    const QRect oldGuest1Geo = guest1->geometry();
+
+    auto item2 = createItem();
+    auto item3 = createItem();
+
+    {
+        LayoutTransaction transaction(root.get());
+        QVERIFY(root->isInTransaction());
+
+        root->insertItem(item2, Item::Location_OnRight);
+        root->insertItem(item3, Item::Location_OnRight);
+
+        {
+            // Nested transactions don't commit
+            LayoutTransaction nested(root.get());
+        }
+
+        QVERIFY(root->isInTransaction());
+        QVERIFY(item1->width() < 1000);
+        QCOMPARE(guest1->geometry(), oldGuest1Geo);
+        QCOMPARE(item1Spy.count(), 0);
+        QCOMPARE(root->separators().size(), 0);
+
+        // Stale widgets and separators are expected, but the item tree is still checked
+        QVERIFY(root->checkSanity());
+        const QRect item3Geo = item3->geometry();
+        item3->setGeometry(item3Geo.adjusted(0, 0, -10, 0));
+        QVERIFY(!root->checkSanity());
+        item3->setGeometry(item3Geo);
+        QVERIFY(root->checkSanity());
+    }
+
+    QVERIFY(!root->isInTransaction());
+    QCOMPARE(item1Spy.count(), 1); // Resized twice, notified once
+    QCOMPARE(guest1->geometry(), item1->mapToRoot(item1->rect()));
+    QCOMPARE(root->separators().size(), 2);
+    QVERIFY(root->checkSanity());
+    QVERIFY(serializeDeserializeTest(root));
+}
+
+void TestMultiSplitter::tst_itemForWidget()
+{
+    auto root1 = createRoot();
+    Item *item1 = createItem();
+    Item *item2 = createItem();
+    root1->insertItem(item1, Item::Location_OnLeft);
+    root1->insertItem(item2, Item::Location_OnRight);
+    Widget *guest1 = item1->guestWidget();
+    QObject *guest2 = item2->guestAsQObject();
+
+    QCOMPARE(root1->itemForWidget(guest1), item1);
+    QCOMPARE(root1->itemForObject(guest2), item2);
+
+    // Items coming from another root are found too
+    auto root2 = createRoot();
+    Item *item3 = createItem();
+    root2->insertItem(item3, Item::Location_OnLeft);
+    Widget *guest3 = item3->guestWidget();
+    QVERIFY(!root1->itemForWidget(guest3));
+    root1->insertItem(root2.release(), Item::Location_OnBottom);
+    QCOMPARE(root1->itemForWidget(guest3), item3);
+    QCOMPARE(item3->parentContainer()->itemForWidget(guest3), item3);
+    QVERIFY(!item3->parentContainer()->itemForWidget(guest1));
+    QVERIFY(root1->checkSanity());
+
+    // Placeholders and items with a deleted guest aren't found
+    item1->turnIntoPlaceholder();
+    QVERIFY(!root1->itemForWidget(guest1));
+    delete guest2;
+    QVERIFY(!root1->itemForObject(guest2));
+    QVERIFY(root1->checkSanity());
+}
+
+void TestMultiSplitter::tst_itemAt()
+{
+    // Compares the binary search against a brute-force one
+    auto root = createRoot();
+    Item *item1 = createItem();
+    Item *item2 = createItem();
+    Item *item3 = createItem();
+    Item *item4 = createItem();
+    Item *item5 = createItem();
+    root->insertItem(item1, Item::Location_OnLeft);
+    root->insertItem(item2, Item::Location_OnRight);
+    root->insertItem(item3, Item::Location_OnRight);
+    item2->insertItem(item4, Item::Location_OnBottom);
+    item4->insertItem(item5, Item::Location_OnRight);
+    item3->turnIntoPlaceholder();
+    QVERIFY(root->checkSanity());
+
+    const Item::List items = root->items_recursive();
+    for (int x = 0; x < root->width(); x += 7) {
+        for (int y = 0; y < root->height(); y += 7) {
+            const QPoint pt(x, y);
+            Item *expected = nullptr;
+            for (Item *item : items) {
+                if (item->isVisible() && item->mapToRoot(item->rect()).contains(pt)) {
+                    expected = item;
+                    break;
+                }
+            }
+
+            QCOMPARE(root->itemAt_recursive(pt), expected);
+        }
+    }
+}
+
+void TestMultiSplitter::tst_waterFillMatchesRoundRobin()
+{
+    // calculateSqueezes() and honourMaxSizes() must give the same results as the original loops
+    std::mt19937 generator(1234);
+    auto random = [&generator] (int min, int max) {
+        return std::uniform_int_distribution<int>(min, max)(generator);
+    };
+
+    ItemContainer container(nullptr);
+    container.setSize(QSize(1000, 5000));
+    const Qt::Orientation o = container.orientation();
+
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+        SizingInfo::List sizes;
+        const int count = random(1, 25);
+        int totalAvailable = 0;
+        for (int i = 0; i < count; ++i) {
+            SizingInfo info;
+            const int minLength = random(0, 150);
+            info.minSize = QSize(0, minLength);
+            info.maxSizeHint = QSize(0, minLength + random(0, 400));
+            info.geometry = QRect(0, 0, 100, minLength + random(0, 300));
+            totalAvailable += info.availableLength(o);
+            sizes.push_back(info);
+        }
+
+        const int needed = random(0, totalAvailable);
+        for (auto strategy : { NeighbourSqueezeStrategy::AllNeighbours, NeighbourSqueezeStrategy::ImmediateNeighboursFirst }) {
+            ItemContainer::s_useRoundRobinDistribution = true;
+            const QVector<int> expected = container.calculateSqueezes(sizes.cbegin(), sizes.cend(), needed, strategy);
+            ItemContainer::s_useRoundRobinDistribution = false;
+            QCOMPARE(container.calculateSqueezes(sizes.cbegin(), sizes.cend(), needed, strategy), expected);
+        }
+
+        SizingInfo::List expectedSizes = sizes;
+        ItemContainer::s_useRoundRobinDistribution = true;
+        container.d->honourMaxSizes(expectedSizes);
+        ItemContainer::s_useRoundRobinDistribution = false;
+        container.d->honourMaxSizes(sizes);
+        for (int i = 0; i < count; ++i)
+            QCOMPARE(sizes.at(i).geometry, expectedSizes.at(i).geometry);
+    }
+}
+
+void TestMultiSplitter::tst_separatorsAreReused()
+{
+    // Separators that are no longer needed are hidden and pooled, instead of deleted
+    auto root = createRoot();
+    Item *item1 = createItem();
+    Item *item2 = createItem();
+    Item *item3 = createItem();
+    root->insertItem(item1, Item::Location_OnLeft);
+    root->insertItem(item2, Item::Location_OnRight);
+    root->insertItem(item3, Item::Location_OnRight);
+    const Separator::List originalSeparators = root->separators();
+    QCOMPARE(originalSeparators.size(), 2);
+
+    item3->turnIntoPlaceholder();
+    QCOMPARE(root->separators().size(), 1);
+    for (Separator *separator : originalSeparators) {
+        if (!root->separators().contains(separator))
+            QVERIFY(!separator->asWidget()->isVisible());
+    }
+
+    Item *item4 = createItem();
+    root->insertItem(item4, Item::Location_OnRight);
+    QVERIFY(root->checkSanity());
+
+    const Separator::List separators = root->separators();
+    QCOMPARE(separators.size(), 2);
+    for (Separator *separator : separators) {
+        QVERIFY(originalSeparators.contains(separator));
+        QVERIFY(separator->asWidget()->isVisible());
+    }
+
+    // Separators read the flags when created, so changing them drops the pool
+    item4->turnIntoPlaceholder();
+    QCOMPARE(root->separators().size(), 1);
+    const Config::Flags oldFlags = Config::self().flags();
+    Config::self().setFlags(Config::Flag::FramePacedResize);
+    Item *item5 = createItem();
+    root->insertItem(item5, Item::Location_OnRight);
+    Config::self().setFlags(oldFlags);
+    QCOMPARE(root->separators().size(), 2);
+    QVERIFY(!originalSeparators.contains(root->separators().constLast()));
+    QVERIFY(root->checkSanity());
+}
+
+void TestMultiSplitter::tst_generation()
+{
+    auto root1 = createRoot();
+    auto root2 = createRoot();
+    QVERIFY(root1->generation() != root2->generation());
+
+    Item *item1 = createItem();
+    Item *item2 = createItem();
+    root1->insertItem(item1, Item::Location_OnLeft);
+    quint64 generation = root1->generation();
+    root1->insertItem(item2, Item::Location_OnRight);
+    QVERIFY(root1->generation() != generation);
+
+    // Only changes when something we save changes
+    generation = root1->generation();
+    root1->toJsonObject();
+    root1->setSize_recursive(root1->size());
+    QCOMPARE(root1->generation(), generation);
+
+    root1->setSize_recursive(QSize(900, 900));
+    QVERIFY(root1->generation() != generation);
+
+    generation = root1->generation();
+    item2->turnIntoPlaceholder();
+    QVERIFY(root1->generation() != generation);
+
+    generation = root1->generation();
+    item1->guestAsQObject()->setObjectName(QStringLiteral("renamed"));
+    QVERIFY(root1->generation() != generation);
+}
+
+void TestMultiSplitter::tst_aboutToClear()
+{
+    auto root = createRoot();
+    Item *item1 = createItem();
+    Item *item2 = createItem();
+    Item *item3 = createItem();
+    root->insertItem(item1, Item::Location_OnLeft);
+    root->insertItem(item2, Item::Location_OnRight);
+    root->insertItem(item3, Item::Location_OnRight);
+    QVERIFY(!root->isAboutToClear());
+
+    const QRect geo3 = item3->geometry();
+    root->aboutToClear();
+    QVERIFY(root->isAboutToClear());
+
+    // The neighbours don't grow, as everything is going away anyway
+    item2->turnIntoPlaceholder();
+    root->removeItem(item1);
+    QCOMPARE(item3->geometry(), geo3);
+    QCOMPARE(root->numChildren(), 2);
+
+    root->clear();
+    QVERIFY(!root->isAboutToClear());
+    QCOMPARE(root->numChildren(), 0);
+
+    // Back to normal
+    Item *item4 = createItem();
+    Item *item5 = createItem();
+    root->insertItem(item4, Item::Location_OnLeft);
+    root->insertItem(item5, Item::Location_OnRight);
+    root->removeItem(item4);
+    QCOMPARE(item5->geometry(), root->rect());
+    QVERIFY(root->checkSanity());
+}
+
+void TestMultiSplitter::tst_framePacedSeparatorMove()
+{
+    // Separators read the flag when created
+    const Config::Flags oldFlags = Config::self().flags();
+    Config::self().setFlags(Config::Flag::FramePacedResize);
+
+    auto root = createRoot();
+    Item *item1 = createItem();
+    Item *item2 = createItem();
+    root->insertItem(item1, Item::Location_OnLeft);
+    root->insertItem(item2, Item::Location_OnRight);
+    Config::self().setFlags(oldFlags);
+
+    Separator *separator = root->separators().constFirst();
+    const int pos = separator->position();
+    QSignalSpy item1Spy(item1, &Item::geometryChanged);
+
+    // Several moves within a frame only apply the last one
+    separator->onMousePress();
+    separator->dragTo(pos + 10);
+    separator->dragTo(pos + 20);
+    separator->dragTo(pos + 30);
+    QCOMPARE(separator->position(), pos);
+    QTRY_COMPARE(separator->position(), pos + 30);
+    QCOMPARE(item1Spy.count(), 1);
+
+    // The pending move is flushed on release
+    separator->dragTo(pos + 40);
+    separator->onMouseReleased();
+    QCOMPARE(separator->position(), pos + 40);
+    QCOMPARE(item1Spy.count(), 2);
+    QVERIFY(root->checkSanity());
+}
+
+void TestMultiSplitter::tst_itemArena()
+{
+    if (!ItemArena::isEnabled())
+        QSKIP("Items aren't allocated from arenas in AddressSanitizer builds");
+
+    // Items the layout creates come from the root's arena
+    auto root = createRoot();
+    ItemArena *arena = root->arena();
+    QVERIFY(arena);
+    QCOMPARE(arena->numLiveItems(), 0);
+    root->insertItem(createItem(), Item::Location_OnLeft);
+    root->insertItem(createItem(), Item::Location_OnRight);
+    root->insertItem(createItem(), Item::Location_OnTop); // Moves the first two into a new container
+    QCOMPARE(arena->numLiveItems(), 1);
+
+    // Deserializing allocates the whole tree from the arena
+    const QJsonObject serialized = root->toJsonObject();
+    QHash<QString, Widget*> widgets;
+    for (Item *item : root->items_recursive())
+        if (auto w = static_cast<MyGuestWidget*>(item->guestAsQObject()))
+            widgets.insert(w->id(), w);
+
+    std::unique_ptr<ItemContainer> root2(new ItemContainer(root->hostWidget()));
+    root2->fillFromJsonObject(serialized, widgets);
+    QVERIFY(root2->checkSanity());
+    QCOMPARE(root2->arena()->numLiveItems(), root2->items_recursive().size() + 1); // The items plus the container
+    QVERIFY(root2->arena()->numChunks() > 0);
+
+    // Clearing releases the memory in one go
+    root2->clear();
+    QCOMPARE(root2->arena()->numLiveItems(), 0);
+    QVERIFY(root2->arena()->numChunks() <= 1);
+
+    // Items can outlive their root, the arena is then deleted with the last one
+    Item *item = new (root2->arena()) Item(nullptr);
+    root2.reset();
+    delete item;
+}
+
 int main(int argc, char *argv[])
 {
     bool qpaPassed = false;
@@ -191,6 +191,9 @@ void MultiSplitter::addWidget(QWidgetOrQuick *w, Location location,
     if (!validateInputs(w, location, relativeToWidget, option))
         return;
 
+    // Widget geometries, separators and geometry signals are only updated once, at the end
+    Layouting::LayoutTransaction transaction(m_rootItem);
+
     Layouting::Item *relativeTo = itemForFrame(relativeToWidget);
     if (!relativeTo)
         relativeTo = m_rootItem;
@@ -202,10 +205,10 @@ void MultiSplitter::addWidget(QWidgetOrQuick *w, Location location,
     auto dw = qobject_cast<DockWidgetBase*>(w);
 
     if (frame) {
-        newItem = new Layouting::Item(this);
+        newItem = new (m_rootItem->arena()) Layouting::Item(this);
         newItem->setGuestWidget(frame);
     } else if (dw) {
-        newItem = new Layouting::Item(this);
+        newItem = new (m_rootItem->arena()) Layouting::Item(this);
         frame = Config::self().frameworkWidgetFactory()->createFrame();
         newItem->setGuestWidget(frame);
         frame->addWidget(dw, option);
@@ -330,6 +333,8 @@ Frame::List MultiSplitter::frames() const
 
 void MultiSplitter::restorePlaceholder(DockWidgetBase *dw, Layouting::Item *item, int tabIndex)
 {
+    Layouting::LayoutTransaction transaction(m_rootItem);
+
     if (item->isPlaceholder()) {
         Frame *newFrame = Config::self().frameworkWidgetFactory()->createFrame(this);
         item->restore(newFrame);
@@ -410,6 +415,8 @@ void MultiSplitter::setRootItem(Layouting::ItemContainer *root)
 {
     delete m_rootItem;
     m_rootItem = root;
+    invalidateDropRectCache();
+
     connect(m_rootItem, &Layouting::ItemContainer::numVisibleItemsChanged,
             this, &MultiSplitter::visibleWidgetCountChanged);
     connect(m_rootItem, &Layouting::ItemContainer::minSizeChanged, this, [this] {
@@ -430,37 +437,80 @@ Layouting::ItemContainer *MultiSplitter::rootItem() const
 QRect MultiSplitter::rectForDrop(const QWidgetOrQuick *widget, Location location,
                                  const Layouting::Item *relativeTo) const
 {
-    Layouting::Item item(nullptr);
+    QSize size;
+    QSize minSize;
+    QSize maxSize;
 
     if (auto fw = qobject_cast<const FloatingWindow*>(widget)) {
         Layouting::ItemContainer *root = fw->dropArea()->rootItem();
-        item.setSize(root->size());
-        item.setMinSize(root->minSize());
-        item.setMaxSizeHint(root->maxSizeHint());
+        size = root->size();
+        minSize = root->minSize();
+        maxSize = root->maxSizeHint();
     } else {
-        item.setSize(widget->size());
-        item.setMinSize(Layouting::Widget_qwidget::widgetMinSize(widget));
-        item.setMaxSizeHint(Layouting::Widget_qwidget::widgetMaxSize(widget));
+        size = widget->size();
+        minSize = Layouting::Widget_qwidget::widgetMinSize(widget);
+        maxSize = Layouting::Widget_qwidget::widgetMaxSize(widget);
+    }
+
+    // Any change to the layout, even deep inside a nested container, bumps the root's generation.
+    // Items can only be deleted by changing the layout, so the Item* keys can't alias either.
+    const quint64 generation = m_rootItem->generation();
+    if (generation != m_dropRectCache.generation || size != m_dropRectCache.size
+        || minSize != m_dropRectCache.minSize || maxSize != m_dropRectCache.maxSize) {
+        // The layout changed, a different window is being dragged, or it changed its size constraints
+        m_dropRectCache.rects.clear();
+        m_dropRectCache.generation = generation;
+        m_dropRectCache.size = size;
+        m_dropRectCache.minSize = minSize;
+        m_dropRectCache.maxSize = maxSize;
     }
 
+    const auto key = qMakePair(relativeTo, int(location));
+    auto it = m_dropRectCache.rects.constFind(key);
+    if (it != m_dropRectCache.rects.cend())
+        return *it;
+
+    Layouting::Item item(nullptr);
+    item.setSize(size);
+    item.setMinSize(minSize);
+    item.setMaxSizeHint(maxSize);
+
     Layouting::ItemContainer *container = relativeTo ? relativeTo->parentContainer()
                                                      : m_rootItem;
 
-    return container->suggestedDropRect(&item, relativeTo, Layouting::Item::Location(location));
+    const QRect rect = container->suggestedDropRect(&item, relativeTo, Layouting::Item::Location(location));
+    m_dropRectCache.rects.insert(key, rect);
+
+    return rect;
 }
 
-bool MultiSplitter::deserialize(const LayoutSaver::MultiSplitter &l)
+void MultiSplitter::invalidateDropRectCache()
 {
+    m_dropRectCache.rects.clear();
+}
+
+bool MultiSplitter::deserialize(const LayoutSaver::MultiSplitter &l, const QHash<QString, Frame *> &reusedFrames)
+{
+    // Items don't own their frames, so reused frames survive the old items. Those are only left
+    // when a floating window is reused, main windows were cleared already.
+    if (m_rootItem)
+        m_rootItem->clear();
     setRootItem(new Layouting::ItemContainer(this));
+    Layouting::LayoutTransaction transaction(m_rootItem);
 
     QHash<QString, Layouting::Widget*> frames;
     for (const LayoutSaver::Frame &frame : qAsConst(l.frames)) {
-        Frame *f = Frame::deserialize(frame);
         Q_ASSERT(!frame.id.isEmpty());
+        Frame *f = reusedFrames.value(frame.id);
+        if (f) {
+            f->restoreState(frame);
+        } else {
+            f = Frame::deserialize(frame);
+        }
         frames.insert(frame.id, f);
     }
 
-    m_rootItem->fillFromVariantMap(l.layout, frames);
+    m_rootItem->fillFromJsonObject(l.layout, frames);
 
     updateSizeConstraints();
     m_rootItem->setSize_recursive(QWidget::size());
@@ -468,18 +518,78 @@ bool MultiSplitter::deserialize(const LayoutSaver::MultiSplitter &l)
     return true;
 }
 
+bool MultiSplitter::restoreGeometries(const LayoutSaver::MultiSplitter &l)
+{
+    Layouting::LayoutTransaction transaction(m_rootItem);
+    if (!m_rootItem->restoreGeometries(l.layout))
+        return false;
+
+    m_rootItem->setSize_recursive(QWidget::size());
+
+    return true;
+}
+
+MultiSplitter::SerializationCache &MultiSplitter::serializationCache() const
+{
+    SerializationCache &cache = m_serializationCache;
+    const quint64 generation = m_rootItem->generation();
+    if (cache.generation != generation) {
+        cache = SerializationCache();
+        cache.generation = generation;
+    }
+
+    if (!cache.hasItems) {
+        cache.items = m_rootItem->items_recursive();
+        cache.itemIndexes.reserve(cache.items.size());
+        for (int i = 0; i < cache.items.size(); ++i)
+            cache.itemIndexes.insert(cache.items.at(i), i);
+        cache.hasItems = true;
+    }
+
+    return cache;
+}
+
+int MultiSplitter::indexOfItem(const Layouting::Item *item) const
+{
+    return serializationCache().itemIndexes.value(item, -1);
+}
+
 LayoutSaver::MultiSplitter MultiSplitter::serialize() const
 {
-    LayoutSaver::MultiSplitter l;
-    l.layout = m_rootItem->toVariantMap();
-    const Layouting::Item::List items = m_rootItem->items_recursive();
-    l.frames.reserve(items.size());
-    for (Layouting::Item *item : items) {
+    SerializationCache &cache = serializationCache();
+
+    // Tabs can change without the item tree changing. Frame generations are shared and only grow,
+    // so any frame changing raises the highest one.
+    Frame::List currentFrames;
+    currentFrames.reserve(cache.items.size());
+    quint64 framesGeneration = 0;
+    for (Layouting::Item *item : qAsConst(cache.items)) {
         if (!item->isContainer()) {
-            if (auto frame = qobject_cast<Frame*>(item->guestAsQObject()))
-                l.frames.insert(frame->id(), frame->serialize());
+            if (auto frame = qobject_cast<Frame*>(item->guestAsQObject())) {
+                currentFrames.push_back(frame);
+                framesGeneration = qMax(framesGeneration, frame->generation());
+            }
         }
     }
 
-    return l;
+    if (!cache.hasLayout) {
+        cache.layout.layout = m_rootItem->toJsonObject();
+        cache.hasLayout = true;
+    } else if (cache.framesGeneration == framesGeneration) {
+        return cache.layout;
+    }
+
+    cache.framesGeneration = framesGeneration;
+    cache.layout.frames.clear();
+    cache.layout.frames.reserve(currentFrames.size());
+    for (Frame *frame : qAsConst(currentFrames)) {
+        LayoutSaver::Frame saved = frame->serialize();
+        // The cache outlives this save and LayoutAutoSaver reads it from its thread, so it doesn't
+        // keep the shared instances of LayoutSaver::DockWidget::s_dockWidgets, which restoring modifies
+        for (LayoutSaver::DockWidget::Ptr &dw : saved.dockWidgets)
+            dw = std::make_shared<LayoutSaver::DockWidget>(*dw);
+        cache.layout.frames.insert(frame->id(), saved);
+    }
+
+    return cache.layout;
 }
@@ -38,6 +38,7 @@
 #include "KDDockWidgets.h"
 #include "LayoutSaver_p.h"
 
+#include <QHash>
 
 namespace Layouting {
 class Item;
@@ -131,6 +132,12 @@ public:
      */
     const QVector<Layouting::Item*> items() const;
 
+    /**
+     * @brief Returns the index of @p item in @ref items(), or -1 if it's not in this layout.
+     * Memoized until the layout changes, so saving many dock widgets doesn't scan the layout for each one.
+     */
+    int indexOfItem(const Layouting::Item *item) const;
+
     /**
      * @brief Returns the root container item
      */
@@ -144,9 +151,27 @@ public:
      */
     QRect rectForDrop(const QWidgetOrQuick *widget, KDDockWidgets::Location location, const Layouting::Item *relativeTo) const;
 
-    bool deserialize(const LayoutSaver::MultiSplitter &);
+    /**
+     * @brief Discards the rects memoized by @ref rectForDrop
+     * Not needed when the layout changes, as the cache is keyed on the root's generation. Called at drag start.
+     */
+    void invalidateDropRectCache();
+
+    /**
+     * @brief Rebuilds the layout from @p l
+     * Frames found in @p reusedFrames, keyed by saved frame id, are put back into the new item tree
+     * instead of being recreated, see RestoreOption_Incremental.
+     */
+    bool deserialize(const LayoutSaver::MultiSplitter &l,
+                     const QHash<QString, Frame *> &reusedFrames = QHash<QString, Frame *>());
     LayoutSaver::MultiSplitter serialize() const;
 
+    /**
+     * @brief Resizes the current items to the geometries saved in @p l, without recreating them
+     * Returns false if @p l has a different item tree. @sa Layouting::ItemContainer::restoreGeometries()
+     */
+    bool restoreGeometries(const LayoutSaver::MultiSplitter &l);
+
     ///@brief returns the list of separators
     QVector<Layouting::Separator*> separators() const;
 
@@ -266,6 +291,33 @@ private:
     QSize availableSize() const;
 
     Layouting::ItemContainer *m_rootItem = nullptr;
+
+    ///@brief The rects returned by rectForDrop(), for the item being dropped, so hovering the
+    ///indicators doesn't need to simulate the drop each time.
+    struct DropRectCache {
+        // The root's generation the rects were computed for
+        quint64 generation = 0;
+        // The item being dropped. The rect only depends on its sizing, not on the actual widget
+        QSize size;
+        QSize minSize;
+        QSize maxSize;
+        QHash<QPair<const Layouting::Item*, int>, QRect> rects;
+    };
+    mutable DropRectCache m_dropRectCache;
+
+    ///@brief What serialize() and indexOfItem() computed for the root's generation.
+    ///So saving a layout that didn't change doesn't walk the whole item tree again.
+    struct SerializationCache {
+        quint64 generation = 0;
+        bool hasLayout = false;
+        quint64 framesGeneration = 0; // The highest Frame::generation() when layout was saved
+        LayoutSaver::MultiSplitter layout;
+        bool hasItems = false;
+        Layouting::Item::List items;
+        QHash<const Layouting::Item*, int> itemIndexes;
+    };
+    SerializationCache &serializationCache() const;
+    mutable SerializationCache m_serializationCache;
 };
 
 }
@@ -30,6 +30,8 @@
 #include "Config.h"
 #include "FrameworkWidgetFactory.h"
 
+#include <QTabBar>
+
 using namespace KDDockWidgets;
 
 TabWidgetWidget::TabWidgetWidget(Frame *parent)
@@ -39,6 +41,7 @@ TabWidgetWidget::TabWidgetWidget(Frame *parent)
 {
     setTabBar(static_cast<QTabBar*>(m_tabBar->asWidget()));
     setTabsClosable(Config::self().flags() & Config::Flag_TabsHaveCloseButton);
+    connect(QTabWidget::tabBar(), &QTabBar::tabMoved, this, [this] { onTabMoved(); });
 
     // In case tabs closable is set by the factory, a tabClosedRequested() is emitted when the user presses [x]
     connect(this, &QTabWidget::tabCloseRequested, this, [this] (int index) {
@@ -0,0 +1,344 @@
+/*
+  This file is part of KDDockWidgets.
+
+  Copyright (C) 2018-2020 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+  Author: Sérgio Martins <sergio.martins@kdab.com>
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * Load-time benchmark for LayoutSaver.
+ *
+ * Parses layout files into LayoutSaver::Layout, both from JSON (fromJson()) and from the binary
+ * format (fromData()).
+ * No windows are created, only the parsing is timed. Layouts are either generated, with a given
+ * number of dock widgets, or read from files passed with --file.
+ *
+ * Run with -platform offscreen if there's no display. Output is JSON lines, or CSV with --csv.
+ */
+
+#include "LayoutSaver_p.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <algorithm>
+#include <functional>
+
+using namespace KDDockWidgets;
+
+namespace {
+
+class Reporter
+{
+public:
+    explicit Reporter(bool csv)
+        : m_csv(csv)
+        , m_out(stdout)
+    {
+        if (m_csv)
+            m_out << "benchmark,layout,bytes,iterations,total_ns,mean_ns,median_ns,min_ns,max_ns\n";
+    }
+
+    void report(const QString &name, const QString &layoutName, int bytes, QVector<qint64> samples)
+    {
+        if (samples.isEmpty())
+            return;
+
+        std::sort(samples.begin(), samples.end());
+        qint64 total = 0;
+        for (qint64 s : qAsConst(samples))
+            total += s;
+
+        const qint64 mean = total / samples.size();
+        const qint64 median = samples.at(samples.size() / 2);
+
+        if (m_csv) {
+            m_out << name << ',' << layoutName << ',' << bytes << ',' << samples.size() << ','
+                  << total << ',' << mean << ',' << median << ','
+                  << samples.first() << ',' << samples.last() << '\n';
+        } else {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("benchmark"), name);
+            obj.insert(QStringLiteral("layout"), layoutName);
+            obj.insert(QStringLiteral("bytes"), bytes);
+            obj.insert(QStringLiteral("iterations"), samples.size());
+            obj.insert(QStringLiteral("total_ns"), double(total));
+            obj.insert(QStringLiteral("mean_ns"), double(mean));
+            obj.insert(QStringLiteral("median_ns"), double(median));
+            obj.insert(QStringLiteral("min_ns"), double(samples.first()));
+            obj.insert(QStringLiteral("max_ns"), double(samples.last()));
+            m_out << QJsonDocument(obj).toJson(QJsonDocument::Compact) << '\n';
+        }
+
+        m_out.flush();
+    }
+
+private:
+    const bool m_csv;
+    QTextStream m_out;
+};
+
+QJsonObject rectToJson(QRect r)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("x"), r.x());
+    obj.insert(QStringLiteral("y"), r.y());
+    obj.insert(QStringLiteral("width"), r.width());
+    obj.insert(QStringLiteral("height"), r.height());
+    return obj;
+}
+
+QJsonObject sizeToJson(QSize s)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("width"), s.width());
+    obj.insert(QStringLiteral("height"), s.height());
+    return obj;
+}
+
+QJsonObject itemToJson(QRect geometry, const QString &guestId)
+{
+    QJsonObject sizingInfo;
+    sizingInfo.insert(QStringLiteral("geometry"), rectToJson(geometry));
+    sizingInfo.insert(QStringLiteral("minSize"), sizeToJson(QSize(80, 90)));
+    sizingInfo.insert(QStringLiteral("maxSize"), sizeToJson(QSize(16777215, 16777215)));
+
+    QJsonObject item;
+    item.insert(QStringLiteral("sizingInfo"), sizingInfo);
+    item.insert(QStringLiteral("isVisible"), true);
+    item.insert(QStringLiteral("isContainer"), guestId.isEmpty());
+    item.insert(QStringLiteral("objectName"), guestId.isEmpty() ? QStringLiteral("container") : guestId);
+    if (!guestId.isEmpty())
+        item.insert(QStringLiteral("guestId"), guestId);
+    return item;
+}
+
+///@brief Generates a layout with @p numDockWidgets, two tabs per frame, 64 frames per main window
+QByteArray generateLayout(int numDockWidgets)
+{
+    const int tabsPerFrame = 2;
+    const int framesPerMainWindow = 64;
+    const int framesPerColumn = 8;
+
+    QJsonArray mainWindows;
+    QJsonArray allDockWidgets;
+    QJsonArray closedDockWidgets;
+
+    int dockIndex = 0;
+    int frameIndex = 0;
+    while (dockIndex < numDockWidgets) {
+        const QString mainWindowName = QStringLiteral("MainWindow-%1").arg(mainWindows.size());
+        QJsonObject frames;
+        QJsonArray columns;
+        QJsonArray column;
+
+        for (int f = 0; f < framesPerMainWindow && dockIndex < numDockWidgets; ++f) {
+            const QString frameId = QString::number(++frameIndex);
+            const QRect geometry((f / framesPerColumn) * 100, (f % framesPerColumn) * 100, 100, 100);
+
+            QJsonArray dockNames;
+            for (int t = 0; t < tabsPerFrame && dockIndex < numDockWidgets; ++t) {
+                const QString dockName = QStringLiteral("dock-%1").arg(dockIndex++);
+                dockNames.append(dockName);
+
+                QJsonObject placeholder;
+                placeholder.insert(QStringLiteral("isFloatingWindow"), false);
+                placeholder.insert(QStringLiteral("itemIndex"), f);
+                placeholder.insert(QStringLiteral("mainWindowUniqueName"), mainWindowName);
+
+                QJsonObject lastPosition;
+                lastPosition.insert(QStringLiteral("lastFloatingGeometry"), rectToJson(QRect(10, 10, 400, 300)));
+                lastPosition.insert(QStringLiteral("tabIndex"), t);
+                lastPosition.insert(QStringLiteral("wasFloating"), false);
+                lastPosition.insert(QStringLiteral("placeholders"), QJsonArray { placeholder, placeholder });
+
+                QJsonObject dw;
+                dw.insert(QStringLiteral("uniqueName"), dockName);
+                dw.insert(QStringLiteral("lastPosition"), lastPosition);
+                allDockWidgets.append(dw);
+
+                if (dockIndex % 10 == 0)
+                    closedDockWidgets.append(dockName);
+            }
+
+            QJsonObject frame;
+            frame.insert(QStringLiteral("id"), frameId);
+            frame.insert(QStringLiteral("isNull"), false);
+            frame.insert(QStringLiteral("objectName"), QStringLiteral("Frame-%1").arg(frameId));
+            frame.insert(QStringLiteral("geometry"), rectToJson(geometry));
+            frame.insert(QStringLiteral("options"), 0);
+            frame.insert(QStringLiteral("currentTabIndex"), 0);
+            frame.insert(QStringLiteral("dockWidgets"), dockNames);
+            frames.insert(frameId, frame);
+
+            column.append(itemToJson(geometry, frameId));
+            if (column.size() == framesPerColumn) {
+                QJsonObject container = itemToJson(QRect(), QString());
+                container.insert(QStringLiteral("orientation"), int(Qt::Vertical));
+                container.insert(QStringLiteral("children"), column);
+                columns.append(container);
+                column = QJsonArray();
+            }
+        }
+
+        if (!column.isEmpty()) {
+            QJsonObject container = itemToJson(QRect(), QString());
+            container.insert(QStringLiteral("orientation"), int(Qt::Vertical));
+            container.insert(QStringLiteral("children"), column);
+            columns.append(container);
+        }
+
+        QJsonObject root = itemToJson(QRect(0, 0, 800, 800), QString());
+        root.insert(QStringLiteral("orientation"), int(Qt::Horizontal));
+        root.insert(QStringLiteral("children"), columns);
+
+        QJsonObject multiSplitter;
+        multiSplitter.insert(QStringLiteral("layout"), root);
+        multiSplitter.insert(QStringLiteral("frames"), frames);
+
+        QJsonObject mainWindow;
+        mainWindow.insert(QStringLiteral("uniqueName"), mainWindowName);
+        mainWindow.insert(QStringLiteral("options"), 1);
+        mainWindow.insert(QStringLiteral("geometry"), rectToJson(QRect(0, 0, 800, 800)));
+        mainWindow.insert(QStringLiteral("screenIndex"), 0);
+        mainWindow.insert(QStringLiteral("screenSize"), sizeToJson(QSize(1920, 1080)));
+        mainWindow.insert(QStringLiteral("isVisible"), true);
+        mainWindow.insert(QStringLiteral("affinities"), QJsonArray());
+        mainWindow.insert(QStringLiteral("multiSplitterLayout"), multiSplitter);
+        mainWindows.append(mainWindow);
+    }
+
+    QJsonObject layout;
+    layout.insert(QStringLiteral("serializationVersion"), KDDOCKWIDGETS_SERIALIZATION_VERSION);
+    layout.insert(QStringLiteral("mainWindows"), mainWindows);
+    layout.insert(QStringLiteral("floatingWindows"), QJsonArray());
+    layout.insert(QStringLiteral("closedDockWidgets"), closedDockWidgets);
+    layout.insert(QStringLiteral("allDockWidgets"), allDockWidgets);
+    layout.insert(QStringLiteral("screenInfo"), QJsonArray());
+
+    return QJsonDocument(layout).toJson();
+}
+
+QVector<qint64> measure(int iterations, const std::function<bool()> &func)
+{
+    QVector<qint64> samples;
+    samples.reserve(iterations);
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        timer.start();
+        if (!func()) {
+            qWarning() << "Failed to load layout";
+            return {};
+        }
+        samples.push_back(timer.nsecsElapsed());
+    }
+
+    return samples;
+}
+
+void benchmarkLayout(Reporter &reporter, const QString &layoutName, const QByteArray &json, int iterations)
+{
+    reporter.report(QStringLiteral("json_direct"), layoutName, json.size(),
+                    measure(iterations, [&json] {
+        LayoutSaver::Layout layout;
+        return layout.fromJson(json);
+    }));
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    const QByteArray binary = LayoutSaver::convertLayout(json, LayoutSaver::Format::Binary);
+
+    reporter.report(QStringLiteral("binary_direct"), layoutName, binary.size(),
+                    measure(iterations, [&binary] {
+        LayoutSaver::Layout layout;
+        return layout.fromData(binary);
+    }));
+#endif
+}
+
+QVector<int> parseIntList(const QString &str)
+{
+    QVector<int> result;
+    const QStringList parts = str.split(QLatin1Char(','));
+    for (const QString &part : parts) {
+        // Empty parts don't parse as a number, so they're skipped too
+        bool ok = false;
+        const int value = part.trimmed().toInt(&ok);
+        if (ok && value > 0)
+            result.append(value);
+    }
+
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv); // LayoutSaver::Layout queries the screens
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Load-time benchmark for LayoutSaver"));
+    parser.addHelpOption();
+
+    QCommandLineOption sizesOption(QStringLiteral("sizes"),
+                                   QStringLiteral("Comma separated list of dock widget counts for generated layouts"),
+                                   QStringLiteral("list"), QStringLiteral("100,1000,10000"));
+    QCommandLineOption fileOption(QStringLiteral("file"),
+                                  QStringLiteral("Benchmark this layout file instead of generated ones. Can be repeated"),
+                                  QStringLiteral("path"));
+    QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+                                        QStringLiteral("Iterations for each benchmark"),
+                                        QStringLiteral("n"), QStringLiteral("20"));
+    QCommandLineOption csvOption(QStringLiteral("csv"), QStringLiteral("Output CSV instead of JSON lines"));
+
+    parser.addOption(sizesOption);
+    parser.addOption(fileOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(csvOption);
+    parser.process(app);
+
+    const int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    Reporter reporter(parser.isSet(csvOption));
+
+    const QStringList files = parser.values(fileOption);
+    if (!files.isEmpty()) {
+        for (const QString &filename : files) {
+            QFile f(filename);
+            if (!f.open(QIODevice::ReadOnly)) {
+                qWarning() << "Failed to open" << filename << f.errorString();
+                return 1;
+            }
+
+            // Binary files are converted, so both formats are always measured
+            const QByteArray json = LayoutSaver::convertLayout(f.readAll(), LayoutSaver::Format::Json);
+            benchmarkLayout(reporter, QFileInfo(filename).fileName(), json, iterations);
+        }
+
+        return 0;
+    }
+
+    const QVector<int> sizes = parseIntList(parser.value(sizesOption));
+    for (int numDockWidgets : sizes) {
+        benchmarkLayout(reporter, QStringLiteral("generated-%1").arg(numDockWidgets),
+                        generateLayout(numDockWidgets), iterations);
+    }
+
+    return 0;
+}
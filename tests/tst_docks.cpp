@@ -55,6 +55,11 @@
 #include <QStyleFactory>
 #include <QCursor>
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+# include <QCborMap>
+# include <QCborValue>
+#endif
+
 #ifdef Q_OS_WIN
 # include <Windows.h>
 #endif
@@ -186,6 +191,7 @@ struct EnsureTopLevelsDeleted
 
         // Other cleanup, since we use this class everywhere
         Config::self().setDockWidgetFactoryFunc(nullptr);
+        Config::self().setDockWidgetContentFactoryFunc(nullptr);
         Config::self().setFlags(m_originalFlags);
         Config::self().setSeparatorThickness(m_originalSeparatorThickness);
     }
@@ -324,6 +330,19 @@ private Q_SLOTS:
     void tst_restoreEmbeddedMainWindow();
     void tst_restoreWithDockFactory();
     void tst_restoreResizesLayout();
+    void tst_restoreIncremental();
+    void tst_restoreAsync();
+    void tst_restoreBinaryLayout();
+    void tst_streamedJsonLayout();
+    void tst_loadLayoutWithoutVariants();
+    void tst_autoSave();
+    void tst_serializeCache();
+    void tst_lazyDockWidgetContent();
+    void tst_registryLookups();
+    void tst_layoutForItem();
+    void tst_affinitySet();
+    void tst_addDockWidgetsDeferringGeometry();
+    void tst_dropRectAfterNestedSeparatorMove();
     void tst_invalidLayoutAfterRestore();
     void tst_invalidJSON_data();
     void tst_invalidJSON();
@@ -4879,6 +4898,563 @@ void TestDocks::tst_restoreResizesLayout()
     QVERIFY(layout->checkSanity());
 }
 
+void TestDocks::tst_restoreIncremental()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto layout = m->multiSplitter();
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+    Frame *frame1 = dock1->frame();
+    Frame *frame2 = dock2->frame();
+
+    LayoutSaver saver(RestoreOption_Incremental);
+    const QByteArray saved = saver.serializeLayout();
+
+    // Nothing changed, so the main window is left alone
+    QVERIFY(saver.restoreLayout(saved));
+    QVERIFY(layout->checkSanity());
+    QCOMPARE(dock1->frame(), frame1);
+    QCOMPARE(dock2->frame(), frame2);
+    QCOMPARE(saver.restoredDockWidgets().size(), 2);
+
+    // Only a separator moved, so the frames are kept and just resized
+    Item *item1 = layout->itemForFrame(frame1);
+    const QRect savedGeometry1 = item1->geometry();
+    const QRect savedGeometry2 = layout->itemForFrame(frame2)->geometry();
+    QCOMPARE(layout->separators().size(), 1);
+    layout->rootItem()->requestSeparatorMove(layout->separators().constFirst(), 50);
+    QVERIFY(item1->geometry() != savedGeometry1);
+    QVERIFY(saver.restoreLayout(saved));
+    QVERIFY(layout->checkSanity());
+    QCOMPARE(dock1->frame(), frame1);
+    QCOMPARE(dock2->frame(), frame2);
+    QCOMPARE(layout->itemForFrame(frame1), item1);
+    QCOMPARE(item1->geometry(), savedGeometry1);
+    QCOMPARE(layout->itemForFrame(frame2)->geometry(), savedGeometry2);
+    QCOMPARE(frame1->geometry(), savedGeometry1);
+
+    // The layout changed, so it's rebuilt, but dock1 keeps its frame
+    dock2->close();
+    QVERIFY(saver.restoreLayout(saved));
+    QVERIFY(layout->checkSanity());
+    QVERIFY(dock2->isVisible());
+    QCOMPARE(layout->count(), 2);
+    QCOMPARE(layout->placeholderCount(), 0);
+    QCOMPARE(dock1->frame(), frame1);
+    QCOMPARE(layout->itemForFrame(frame1)->geometry(), savedGeometry1);
+
+    // Floating windows are kept too, along with their frames that didn't change
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+    auto dock4 = createDockWidget("4", new QPushButton("4"));
+    QPointer<FloatingWindow> fw3 = dock3->floatingWindow();
+    Frame *frame3 = dock3->frame();
+    const QByteArray savedFloating = saver.serializeLayout();
+
+    dock3->addDockWidgetToContainingWindow(dock4, Location_OnBottom);
+    QCOMPARE(fw3->frames().size(), 2);
+    QVERIFY(saver.restoreLayout(savedFloating));
+    QVERIFY(fw3);
+    QCOMPARE(dock3->floatingWindow(), fw3.data());
+    QCOMPARE(dock3->frame(), frame3);
+    QCOMPARE(fw3->frames().size(), 1);
+    QVERIFY(dock4->floatingWindow());
+    QVERIFY(dock4->floatingWindow() != fw3);
+    QVERIFY(fw3->multiSplitter()->checkSanity());
+    QCOMPARE(dock1->frame(), frame1);
+}
+
+void TestDocks::tst_restoreAsync()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto layout = m->multiSplitter();
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+
+    LayoutSaver saver;
+    const QByteArray saved = saver.serializeLayout();
+    dock2->close();
+
+    AsyncLayoutRestore *restore = saver.restoreLayoutAsync(saved);
+    QVERIFY(restore);
+    QVERIFY(LayoutSaver::restoreInProgress());
+    {
+        // One at a time, synchronous restores are refused too
+        SetExpectedWarning sew("A restore is already in progress");
+        QVERIFY(!saver.restoreLayoutAsync(saved));
+        QVERIFY(!saver.restoreLayout(saved));
+        QVERIFY(!LayoutSaver().restoreLayout(saved));
+    }
+    QSignalSpy finishedSpy(restore, &AsyncLayoutRestore::finished);
+    QVERIFY(finishedSpy.wait());
+    QVERIFY(finishedSpy.at(0).at(0).toBool());
+    QVERIFY(!LayoutSaver::restoreInProgress());
+    QVERIFY(layout->checkSanity());
+    QVERIFY(dock2->isVisible());
+    QCOMPARE(layout->count(), 2);
+    QCOMPARE(layout->placeholderCount(), 0);
+
+    // Cancelling goes back to the layout we had before
+    dock2->close();
+    restore = saver.restoreLayoutAsync(saved);
+    QVERIFY(restore);
+    QSignalSpy cancelledSpy(restore, &AsyncLayoutRestore::finished);
+    restore->cancel();
+    QCOMPARE(cancelledSpy.size(), 1);
+    QVERIFY(!cancelledSpy.at(0).at(0).toBool());
+    QVERIFY(!LayoutSaver::restoreInProgress());
+    QVERIFY(layout->checkSanity());
+    QVERIFY(dock1->isVisible());
+    QVERIFY(!dock2->isVisible());
+    QCOMPARE(layout->placeholderCount(), 1);
+
+    // Cancelling in the middle of the restore, after the main window was cleared
+    restore = saver.restoreLayoutAsync(saved);
+    QVERIFY(restore);
+    restore->setTimeBudget(1);
+    QSignalSpy midwaySpy(restore, &AsyncLayoutRestore::finished);
+    connect(restore, &AsyncLayoutRestore::progressChanged, restore, [restore] (double progress) {
+        if (progress > 0)
+            restore->cancel();
+    });
+    QVERIFY(midwaySpy.wait());
+    QVERIFY(!LayoutSaver::restoreInProgress());
+    QVERIFY(layout->checkSanity());
+    QVERIFY(dock1->isVisible());
+    QVERIFY(!dock2->isVisible());
+    QCOMPARE(layout->placeholderCount(), 1);
+}
+
+void TestDocks::tst_restoreBinaryLayout()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto layout = m->multiSplitter();
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+
+    LayoutSaver saver;
+    saver.setFormat(LayoutSaver::Format::Binary);
+    const QByteArray binary = saver.serializeLayout();
+    QVERIFY(!binary.isEmpty());
+
+    // Converting to JSON and back doesn't lose anything
+    const QByteArray json = LayoutSaver::convertLayout(binary, LayoutSaver::Format::Json);
+    QVERIFY(QJsonDocument::fromJson(json).isObject());
+    QCOMPARE(LayoutSaver::convertLayout(json, LayoutSaver::Format::Binary), binary);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    QVERIFY(binary.size() < json.size());
+
+    // Keys are stored as integer tags
+    const QCborMap binaryMap = QCborValue::fromCbor(binary).taggedValue().toMap();
+    QVERIFY(!binaryMap.isEmpty());
+    for (auto it = binaryMap.cbegin(), end = binaryMap.cend(); it != end; ++it)
+        QVERIFY(it.key().isInteger());
+#endif
+
+    // The format is detected when restoring
+    dock2->close();
+    QVERIFY(saver.restoreLayout(binary));
+    QVERIFY(layout->checkSanity());
+    QVERIFY(dock2->isVisible());
+
+    dock2->close();
+    QVERIFY(saver.restoreLayout(json));
+    QVERIFY(layout->checkSanity());
+    QVERIFY(dock2->isVisible());
+}
+
+void TestDocks::tst_streamedJsonLayout()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None, "tst_streamedJsonLayout");
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+    auto dock4 = createDockWidget("4", new QPushButton("4"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+    dock1->addDockWidgetAsTab(dock3);
+    dock4->setAffinities({ "a\"b", QStringLiteral("\u00e9\U0001F600") }); // needs escaping
+    dock4->show(); // floating
+    dock2->close();
+
+    LayoutSaver saver;
+    const QByteArray streamed = saver.serializeLayout();
+    QJsonParseError error;
+    const QJsonDocument streamedDoc = QJsonDocument::fromJson(streamed, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+
+    // Same document as going through QVariantMap and QJsonDocument
+    LayoutSaver::Layout layout;
+    QVERIFY(layout.fromJson(streamed));
+    QCOMPARE(streamedDoc, QJsonDocument::fromVariant(layout.toVariantMap()));
+
+    // And saving to a file streams the same thing
+    const QString filename = QStringLiteral("tst_streamedJsonLayout.json");
+    QVERIFY(saver.saveToFile(filename));
+    QFile f(filename);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    QCOMPARE(f.readAll(), streamed);
+    f.close();
+    f.remove();
+}
+
+void TestDocks::tst_loadLayoutWithoutVariants()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None, "tst_loadLayoutWithoutVariants");
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+    auto dock4 = createDockWidget("4", new QPushButton("4"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+    dock1->addDockWidgetAsTab(dock3);
+    dock4->show(); // floating
+    dock2->close();
+
+    LayoutSaver saver;
+    const QByteArray json = saver.serializeLayout();
+
+    // Loading straight from QJsonObject, without any QVariantMap, loses nothing
+    const QJsonDocument expected = QJsonDocument::fromJson(json);
+    LayoutSaver::Layout direct;
+    QVERIFY(direct.fromJson(json));
+    QCOMPARE(QJsonDocument::fromVariant(direct.toVariantMap()), expected);
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+    LayoutSaver::Layout fromBinary;
+    QVERIFY(fromBinary.fromData(LayoutSaver::convertLayout(json, LayoutSaver::Format::Binary)));
+    QCOMPARE(QJsonDocument::fromVariant(fromBinary.toVariantMap()), expected);
+#endif
+}
+
+void TestDocks::tst_autoSave()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None, "tst_autoSave");
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+
+    const QString filename = QStringLiteral("tst_autoSave.json");
+    QFile::remove(filename);
+
+    {
+        LayoutAutoSaver autoSaver(filename);
+        autoSaver.setDebounceInterval(50);
+        QSignalSpy spy(&autoSaver, &LayoutAutoSaver::saveFinished);
+
+        // A burst of requests results in a single save
+        autoSaver.scheduleSave();
+        autoSaver.scheduleSave();
+        autoSaver.scheduleSave();
+        QVERIFY(spy.wait());
+        QTest::qWait(200);
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.at(0).at(0).toBool(), true);
+        QCOMPARE(spy.at(0).at(1).toBool(), true);
+        QVERIFY(QFile::exists(filename));
+
+        // Nothing changed, the file isn't touched
+        spy.clear();
+        autoSaver.saveNow();
+        autoSaver.waitForFinished();
+        QCOMPARE(spy.count(), 1);
+        QCOMPARE(spy.at(0).at(0).toBool(), true);
+        QCOMPARE(spy.at(0).at(1).toBool(), false);
+
+        // A change is written
+        spy.clear();
+        dock2->close();
+        autoSaver.saveNow();
+        autoSaver.saveNow(); // While the first one is still writing
+        autoSaver.waitForFinished();
+        QCOMPARE(spy.count(), 2);
+        QCOMPARE(spy.at(0).at(1).toBool(), true);
+        QCOMPARE(spy.at(1).at(1).toBool(), false);
+    }
+
+    // What was written is the current layout
+    dock2->show();
+    LayoutSaver saver;
+    QVERIFY(saver.restoreFromFile(filename));
+    QVERIFY(!dock2->isVisible());
+    QVERIFY(dock1->isVisible());
+    QFile::remove(filename);
+}
+
+void TestDocks::tst_serializeCache()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto layout = m->multiSplitter();
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+
+    auto checkCache = [layout] {
+        return layout->serialize().layout == layout->rootItem()->toJsonObject();
+    };
+
+    QVERIFY(checkCache());
+    QVERIFY(checkCache()); // From the cache this time
+
+    m->addDockWidget(dock3, Location_OnBottom);
+    QVERIFY(checkCache());
+
+    m->resize(m->size() + QSize(100, 100));
+    QVERIFY(checkCache());
+
+    dock2->close();
+    QVERIFY(checkCache());
+    QCOMPARE(layout->indexOfItem(dock2->lastPositions().lastItem()),
+             layout->items().indexOf(dock2->lastPositions().lastItem()));
+
+    dock2->show();
+    m->addDockWidget(dock2, Location_OnTop);
+    QVERIFY(checkCache());
+
+    // Switching tabs doesn't change the item tree, but the frames are saved again
+    dock1->addDockWidgetAsTab(dock3);
+    Frame *frame = dock1->frame();
+    QCOMPARE(layout->serialize().frames.value(frame->id()).currentTabIndex, frame->currentTabIndex());
+    dock1->setAsCurrentTab();
+    QCOMPARE(layout->serialize().frames.value(frame->id()).currentTabIndex, frame->currentTabIndex());
+    QCOMPARE(frame->currentTabIndex(), 0);
+}
+
+void TestDocks::tst_lazyDockWidgetContent()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    dock1->addDockWidgetAsTab(dock2);
+    dock1->frame()->setCurrentDockWidget(dock1);
+    m->addDockWidget(dock3, Location_OnRight);
+    dock3->close();
+
+    LayoutSaver saver;
+    const QByteArray saved = saver.serializeLayout();
+    delete dock1;
+    delete dock2;
+    delete dock3;
+
+    // Restore creates light-weight dock widgets, their content comes later
+    DockWidgetFactoryFunc func = [] (const QString &name) {
+        return static_cast<DockWidgetBase*>(new DockWidget(name));
+    };
+    DockWidgetContentFactoryFunc contentFunc = [] (DockWidgetBase *dw) {
+        return static_cast<QWidget*>(new QPushButton(dw->uniqueName()));
+    };
+    Config::self().setDockWidgetFactoryFunc(func);
+    Config::self().setDockWidgetContentFactoryFunc(contentFunc);
+    QVERIFY(saver.restoreLayout(saved));
+
+    auto registry = DockRegistry::self();
+    DockWidgetBase *restored1 = registry->dockByName("1");
+    DockWidgetBase *restored2 = registry->dockByName("2");
+    DockWidgetBase *restored3 = registry->dockByName("3");
+    QVERIFY(restored1 && restored2 && restored3);
+
+    // Only the current tab got its content
+    QVERIFY(restored1->widget());
+    QVERIFY(!restored2->widget());
+    QVERIFY(!restored3->widget());
+
+    // The others get it once they're shown
+    restored1->frame()->setCurrentDockWidget(restored2);
+    QVERIFY(restored2->widget());
+    QCOMPARE(restored2->widget()->parentWidget(), restored2);
+
+    delete restored3;
+}
+
+void TestDocks::tst_registryLookups()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None, "mainWindow1");
+    auto guest1 = new QPushButton("1");
+    auto guest2 = new QPushButton("2");
+    auto dock1 = createDockWidget("1", guest1);
+    auto dock2 = createDockWidget("2", guest2);
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+
+    auto registry = DockRegistry::self();
+    QCOMPARE(registry->dockByName("1"), dock1);
+    QCOMPARE(registry->dockByName("3"), dock3);
+    QVERIFY(!registry->dockByName("4"));
+    QCOMPARE(registry->mainWindowByName("mainWindow1"), m.get());
+    QVERIFY(!registry->mainWindowByName("mainWindow2"));
+    QCOMPARE(registry->dockWidgetForGuest(guest1), dock1);
+    QCOMPARE(registry->dockWidgetForGuest(guest2), dock2);
+    QVERIFY(!registry->dockWidgetForGuest(m.get()));
+
+    // Registration order is kept, not the order of the names
+    QCOMPARE(registry->dockWidgets({ "3", "1", "4" }), DockWidgetBase::List({ dock1, dock3 }));
+    QCOMPARE(registry->mainWindows({ "mainWindow1" }), MainWindowBase::List({ m.get() }));
+
+    // Floating windows are found by their window handle
+    FloatingWindow *fw1 = dock1->floatingWindow();
+    FloatingWindow *fw3 = dock3->floatingWindow();
+    QVERIFY(fw1 && fw3);
+    QCOMPARE(registry->floatingWindowForHandle(fw1->windowHandle()), fw1);
+    QCOMPARE(registry->floatingWindowForHandle(fw3->windowHandle()), fw3);
+    QVERIFY(!registry->floatingWindowForHandle(m->windowHandle()));
+
+    delete dock1;
+    QVERIFY(!registry->dockByName("1"));
+    QVERIFY(!registry->dockWidgetForGuest(guest1));
+    QCOMPARE(registry->dockWidgets({ "1", "2" }), DockWidgetBase::List({ dock2 }));
+
+    // A new dock widget can reuse the name
+    auto dock4 = createDockWidget("1", new QPushButton("4"));
+    QCOMPARE(registry->dockByName("1"), dock4);
+    QCOMPARE(registry->floatingWindowForHandle(dock4->window()->windowHandle()), dock4->floatingWindow());
+
+    delete dock2;
+    delete dock3;
+    delete dock4;
+}
+
+void TestDocks::tst_layoutForItem()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    m->addDockWidget(dock1, Location_OnLeft);
+
+    auto registry = DockRegistry::self();
+    Layouting::Item *item1 = dock1->frame()->layoutItem();
+    QCOMPARE(registry->layoutForItem(item1), m->multiSplitter());
+    QVERIFY(registry->itemIsInMainWindow(item1));
+
+    QPointer<FloatingWindow> fw = dock2->floatingWindow();
+    QVERIFY(fw);
+    Layouting::Item *item2 = dock2->frame()->layoutItem();
+    QCOMPARE(registry->layoutForItem(item2), fw->multiSplitter());
+    QVERIFY(!registry->itemIsInMainWindow(item2));
+
+    // Moving it into the main window changes the host of the whole sub-tree
+    m->addDockWidget(dock2, Location_OnRight);
+    item2 = dock2->frame()->layoutItem();
+    QCOMPARE(registry->layoutForItem(item2), m->multiSplitter());
+    QVERIFY(registry->itemIsInMainWindow(item2));
+    QVERIFY(Testing::waitForDeleted(fw));
+}
+
+void TestDocks::tst_affinitySet()
+{
+    QVERIFY(AffinitySet().isEmpty());
+    QVERIFY(AffinitySet().matches(AffinitySet()));
+    QVERIFY(!AffinitySet({ "a" }).matches(AffinitySet()));
+    QVERIFY(AffinitySet({ "a", "b" }).matches(AffinitySet({ "c", "b" })));
+    QVERIFY(!AffinitySet({ "a", "b" }).matches(AffinitySet({ "c" })));
+    QCOMPARE(AffinitySet({ "a", "b" }), AffinitySet({ "b", "a", "a" }));
+
+    // More names than bits
+    QStringList many;
+    for (int i = 0; i < 100; ++i)
+        many << QStringLiteral("tst_affinitySet-%1").arg(i);
+
+    const AffinitySet last(QStringList { many.constLast() });
+    QVERIFY(AffinitySet(many).matches(last));
+    QVERIFY(!AffinitySet(many.mid(0, 90)).matches(last));
+    QVERIFY(!AffinitySet({ "a" }).matches(last));
+
+    // Same semantics as the QStringList overload
+    auto registry = DockRegistry::self();
+    QVERIFY(registry->affinitiesMatch(QStringList(), QStringList()));
+    QVERIFY(registry->affinitiesMatch(QStringList { "a", "b" }, QStringList { "b" }));
+    QVERIFY(!registry->affinitiesMatch(QStringList { "a" }, QStringList()));
+}
+
+void TestDocks::tst_addDockWidgetsDeferringGeometry()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+    auto dock4 = createDockWidget("4", new QPushButton("4"));
+    auto dropArea = m->dropArea();
+    using Placement = MainWindowBase::DockPlacement;
+
+    {
+        // dock4 is relative to a dock widget that comes later. Nothing is docked.
+        SetExpectedWarning sew("isn't in this main window");
+        QVERIFY(!m->addDockWidgetsDeferringGeometry({ Placement(dock1, Location_OnLeft),
+                                                      Placement(dock4, Location_OnBottom, dock2),
+                                                      Placement(dock2, Location_OnRight) }));
+        QCOMPARE(dropArea->numFrames(), 0);
+    }
+
+    QVERIFY(m->addDockWidgetsDeferringGeometry({ Placement(dock1, Location_OnLeft),
+                                                 Placement(dock2, Location_OnRight),
+                                                 Placement(dock3, Location_None, nullptr, dock2),
+                                                 Placement(dock4, Location_OnBottom, dock1) }));
+
+    QCOMPARE(dropArea->numFrames(), 3);
+    QCOMPARE(dock3->frame(), dock2->frame());
+    QVERIFY(dock1->frame()->QWidget::geometry().right() < dock2->frame()->QWidget::geometry().left());
+    QVERIFY(dock1->frame()->QWidget::geometry().bottom() < dock4->frame()->QWidget::geometry().top());
+    QVERIFY(dropArea->checkSanity());
+}
+
+void TestDocks::tst_dropRectAfterNestedSeparatorMove()
+{
+    EnsureTopLevelsDeleted e;
+    auto m = createMainWindow(QSize(800, 500), MainWindowOption_None);
+    auto dock1 = createDockWidget("1", new QPushButton("1"));
+    auto dock2 = createDockWidget("2", new QPushButton("2"));
+    auto dock3 = createDockWidget("3", new QPushButton("3"));
+    auto dock4 = createDockWidget("4", new QPushButton("4"));
+    m->addDockWidget(dock1, Location_OnLeft);
+    m->addDockWidget(dock2, Location_OnRight);
+    m->addDockWidget(dock3, Location_OnBottom, dock2);
+
+    auto layout = m->multiSplitter();
+    Item *item2 = layout->itemForFrame(dock2->frame());
+    ItemContainer *nested = item2->parentContainer();
+    QVERIFY(!nested->isRoot());
+
+    QWidget *dragged = dock4->window();
+    const QRect rectBefore = layout->rectForDrop(dragged, Location_OnRight, item2);
+
+    Separator *separator = nullptr;
+    for (Separator *s : layout->separators()) {
+        if (s->parentContainer() == nested)
+            separator = s;
+    }
+    QVERIFY(separator);
+
+    // Only the nested container changes, the root keeps its geometry
+    const QRect rootGeometry = layout->rootItem()->geometry();
+    nested->requestSeparatorMove(separator, 50);
+    QCOMPARE(layout->rootItem()->geometry(), rootGeometry);
+
+    const QRect rectAfter = layout->rectForDrop(dragged, Location_OnRight, item2);
+    QVERIFY(rectAfter != rectBefore);
+    layout->invalidateDropRectCache();
+    QCOMPARE(rectAfter, layout->rectForDrop(dragged, Location_OnRight, item2));
+}
+
 void TestDocks::tst_resizeWindow_data()
 {
     QTest::addColumn<bool>("doASaveRestore");